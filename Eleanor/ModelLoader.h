@@ -11,119 +11,581 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <mutex>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
+#include "objparser.h"
 #include "TGAImage.h"
+#include "texture.h"
+#include "texturecache.h"
+#include "meshcache.h"
+#include "meshoptimizer.h"
+
+//texture files a material refers to, empty when it has none
+struct ModelMaterial {
+    std::string name;
+    std::string diffuse;
+    std::string normal;
+    std::string specular;
+};
+
+//the textures a material samples, shared by the materials naming the same files
+struct MaterialTextures {
+    std::shared_ptr<const Texture<ColorTexel> > diffuse;
+    std::shared_ptr<const Texture<NormalTexel> > normal;
+    std::shared_ptr<const Texture<ScalarTexel> > specular;
+};
+
+//a run of faces with the same material, drawn with its textures bound
+struct ModelBatch {
+    int material;       //-1 without
+    int firstFace;
+    int faceCount;
+    const MaterialTextures *textures;
+};
+
+//how the vertex buffer stores a vertex's 8 floats
+enum VertexLayout {
+    VERTEX_INTERLEAVED,     //position, normal and uv of a vertex side by side
+    VERTEX_SOA              //all positions, then all normals, then all uvs
+};
 
 class Model {
 private:
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    vector3 *tangents;
+    //Geometry, pointing into the storage of a parsed OBJ or into the mapped
+    //mesh cache. There is one vertex per distinct position/normal/texcoord
+    //index triple of the OBJ, attribute a of vertex id is at a + id*aStride.
+    VertexLayout layout;
+    bool optimize;
+    const float *positions = NULL;
+    const float *normals = NULL;
+    const float *texcoords = NULL;
+    int positionStride = 0, normalStride = 0, texcoordStride = 0;
+    int vertexCount = 0;
+    
+    const uint32_t *indices = NULL;     //vertex of face corner 3*f+k
+    const int *vertexCorners = NULL;    //first face corner of each vertex
+    const vector3 *tangents = NULL;     //per face
+    const int *materialIds = NULL;      //per face
+    int indexCount = 0;
+    
+    std::vector<ModelMaterial> materials;
+    
+    //faces are grouped by material, batches of materials with the same
+    //textures next to each other
+    std::vector<ModelBatch> batches;
+    std::vector<MaterialTextures> textureSets;
+    const MaterialTextures *bound = NULL;
+    
+    //storage of a parsed OBJ
+    std::vector<float> vertexData;
+    std::vector<uint32_t> indexData;
+    std::vector<int> vertexCornerData;
+    std::vector<vector3> tangentData;
+    std::vector<int> materialIdData;
+    std::vector<std::string> materialFiles;     //MTL files the OBJ named
     
-    TGAImage diffuseMap;
-    TGAImage normalMap;
-    TGAImage specularMap;
+    MeshCache cache;
     
-    void loadTexture(std::string filename, const char *suffix, TGAImage &img);
+    TextureFilter filter = FILTER_TRILINEAR;
+    
+    void textureFiles(const std::string &inputfile, int material, std::string files[3]);
+    void groupFaces(const std::string &inputfile, std::vector<tinyobj::index_t> &objIndices);
+    void buildBatches(const std::string &inputfile);
+    void loadObj(const std::string &inputfile);
+    bool loadCache(const std::string &cachefile, const std::string &inputfile);
+    bool saveCache(const std::string &cachefile, const std::string &inputfile);
     void calcTangents();
+    void buildVertices(const tinyobj::attrib_t &attrib, const std::vector<tinyobj::index_t> &objIndices);
+    void setVertexData(const float *data);
+    void optimizeMesh();
+    
+    //what the cache must have been built with, the layout in bit 0
+    uint32_t cacheFlags() const {
+        return (uint32_t)layout | (optimize ? 2u : 0u);
+    }
 public:
-    Model(std::string inputfile) {
-        std::string err;
-        tinyobj::LoadObj(&attrib, &shapes, &materials, &err, inputfile.c_str());
-        if (!err.empty()) {
-            std::cerr << err << std::endl;
-        }
+    //With useCache the geometry comes from the mesh cache next to the OBJ,
+    //model.mesh for model.obj, when it is up to date and was built with the
+    //same options. Otherwise the OBJ is parsed and the cache rewritten.
+    //optimizeOrder reorders faces and vertices for the vertex cache and for
+    //less overdraw once after parsing, the cache keeps the result.
+    //All shapes are kept. Textures are the files each material names, or
+    //model_diffuse.tga, model_nm_tangent.tga and model_spec.tga, loaded
+    //through the shared TextureCache.
+    Model(std::string inputfile, bool useCache = true, VertexLayout vertexLayout = VERTEX_INTERLEAVED, bool optimizeOrder = false)
+        : layout(vertexLayout), optimize(optimizeOrder) {
+        std::string cachefile = inputfile;
+        size_t dot = cachefile.find_last_of(".");
+        size_t slash = cachefile.find_last_of("/");
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) cachefile.erase(dot);
+        cachefile += ".mesh";
         
-        loadTexture(inputfile, "_diffuse.tga", diffuseMap);
-        loadTexture(inputfile, "_nm_tangent.tga", normalMap);
-        loadTexture(inputfile, "_spec.tga", specularMap);
+        if (useCache && loadCache(cachefile, inputfile)) {
+            std::cout << "load mesh cache " << cachefile << std::endl;
+        } else {
+            loadObj(inputfile);
+            if (useCache) {
+                bool ret = saveCache(cachefile, inputfile);
+                std::cout << "write mesh cache " << cachefile << " " << ret << std::endl;
+            }
+        }
         
-        tangents = new vector3[getIndexSize()/3];
-        calcTangents();
+        buildBatches(inputfile);
     }
     
+    //the geometry points into the model itself or its mapping
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    
     int getIndexSize() {
-        return (int) shapes[0].mesh.indices.size();
+        return indexCount;
+    }
+    
+    //vertex of a face corner
+    int getIndex(int nface, int nthvert) {
+        return (int) indices[3*nface + nthvert];
+    }
+    
+    //the index buffer, 3 vertices per face
+    const uint32_t *getIndices() {
+        return indices;
     }
     
-    tinyobj::index_t getIndex(int nface, int nthvert) {
-        return shapes[0].mesh.indices[3*nface + nthvert];
+    int getVertexCount() {
+        return vertexCount;
     }
     
+    int getVertexCorner(int id) {
+        return vertexCorners[id];
+    }
+    
+    VertexLayout getVertexLayout() {return layout;}
+    
     vector3 getVertex(int vid) {
-        vector3 pos;
-        pos.x = attrib.vertices[3 * vid];
-        pos.y = attrib.vertices[3 * vid + 1];
-        pos.z = attrib.vertices[3 * vid + 2];
-        return pos;
+        const float *p = positions + vid * positionStride;
+        return vector3(p[0], p[1], p[2]);
     }
     
     vector3 getNormal(int vid) {
-        vector3 normal;
-        normal.x = attrib.normals[3 * vid];
-        normal.y = attrib.normals[3 * vid + 1];
-        normal.z = attrib.normals[3 * vid + 2];
-        return normal;
+        const float *n = normals + vid * normalStride;
+        return vector3(n[0], n[1], n[2]);
     }
     
     vector2 getUV(int vid) {
-        vector2 uv;
-        uv.x = attrib.texcoords[2 * vid];
-        uv.y = attrib.texcoords[2 * vid + 1];
-        return uv;
+        const float *t = texcoords + vid * texcoordStride;
+        return vector2(t[0], t[1]);
+    }
+    
+    //how the texture lookups with derivatives filter
+    void setTextureFilter(TextureFilter f) {
+        filter = f;
+    }
+    
+    TextureFilter getTextureFilter() {return filter;}
+    
+    int getBatchCount() {
+        return (int) batches.size();
+    }
+    
+    const ModelBatch &getBatch(int i) {
+        return batches[i];
+    }
+    
+    //the textures the lookups below sample, those of the first batch until
+    //another batch's are bound
+    void bindTextures(const MaterialTextures *textures) {
+        bound = textures;
     }
     
     TGAColor getDiffuse(float u, float v) {
-        return diffuseMap.get(u * diffuseMap.width, v * diffuseMap.height);
+        ColorTexel::Type t = bound->diffuse->sample(u, v);
+        return TGAColor((const unsigned char *)&t, 4);
+    }
+    
+    //uv with its screen-space derivatives, which pick the mip level
+    TGAColor getDiffuse(const vector2 &uv, const vector2 &dx, const vector2 &dy) {
+        ColorTexel::Type t = bound->diffuse->sample(uv.x, uv.y, dx, dy, filter);
+        return TGAColor((const unsigned char *)&t, 4);
     }
     
     float getSpecular(float u, float v) {
-        return specularMap.get(u * specularMap.width, v * specularMap.height).bgra[0]/1.0f;
+        return bound->specular->sample(u, v);
+    }
+    
+    float getSpecular(const vector2 &uv, const vector2 &dx, const vector2 &dy) {
+        return bound->specular->sample(uv.x, uv.y, dx, dy, filter);
     }
     
+    //tangent-space normals, unit length
     vector3 getNormal(float u, float v) {
-        TGAColor c = normalMap.get(u * normalMap.width, v * normalMap.height);
-        vector3 res;
-        res.x = (float)c.bgra[2]/255.0f*2.0f-1.0f;
-        res.y = (float)c.bgra[1]/255.0f*2.0f-1.0f;
-        res.z = (float)c.bgra[0]/255.0f*2.0f-1.0f;
-        return res;
+        return bound->normal->sample(u, v);
+    }
+    
+    vector3 getNormal(const vector2 &uv, const vector2 &dx, const vector2 &dy) {
+        vector3 n = bound->normal->sample(uv.x, uv.y, dx, dy, filter);
+        //blending texels shortens the normal
+        if (filter != FILTER_NEAREST) n.normalize();
+        return n;
     }
     
     vector3 getTangent(int f) {
         return tangents[f];
     }
+    
+    int getMaterialCount() {
+        return (int) materials.size();
+    }
+    
+    const ModelMaterial &getMaterial(int id) {
+        return materials[id];
+    }
+    
+    //-1 for a face without material
+    int getMaterialId(int f) {
+        return materialIds[f];
+    }
 };
 
-void Model::loadTexture(std::string filename, const char *suffix, TGAImage &img) {
-    std::string texfile(filename);
-    size_t dot = texfile.find_last_of(".");
-    if (dot != std::string::npos) {
-        texfile = texfile.substr(0, dot) + std::string(suffix);
-        bool ret = img.read_tga_file(texfile.c_str());
-        std::cout << "load texture file " << texfile << " " << ret << std::endl;
-        img.flip_vertically();
+void Model::loadObj(const std::string &inputfile) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> objMaterials;
+    std::string err;
+    //material files are relative to the OBJ
+    std::string basedir = inputfile.substr(0, inputfile.find_last_of("/") + 1);
+    {
+        //every model parses on one pool, one file at a time
+        static ThreadPool pool;
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+        ObjParser parser(pool);
+        parser.load(&attrib, &shapes, &objMaterials, &err, inputfile.c_str(), basedir.c_str());
+        materialFiles = parser.getMaterialFiles();
+    }
+    if (!err.empty()) {
+        std::cerr << err << std::endl;
+    }
+    
+    std::vector<tinyobj::index_t> objIndices;
+    materialIdData.clear();
+    for (size_t s = 0; s < shapes.size(); s++) {
+        const tinyobj::mesh_t &mesh = shapes[s].mesh;
+        objIndices.insert(objIndices.end(), mesh.indices.begin(), mesh.indices.end());
+        materialIdData.insert(materialIdData.end(), mesh.material_ids.begin(), mesh.material_ids.end());
+        materialIdData.resize(objIndices.size()/3, -1);
+    }
+    for (size_t f = 0; f < materialIdData.size(); f++) {
+        if (materialIdData[f] >= (int) objMaterials.size()) materialIdData[f] = -1;
+    }
+    materials.clear();
+    for (size_t i = 0; i < objMaterials.size(); i++) {
+        ModelMaterial m;
+        m.name = objMaterials[i].name;
+        m.diffuse = objMaterials[i].diffuse_texname;
+        m.normal = objMaterials[i].normal_texname.empty() ? objMaterials[i].bump_texname : objMaterials[i].normal_texname;
+        m.specular = objMaterials[i].specular_texname;
+        materials.push_back(m);
+    }
+    
+    groupFaces(inputfile, objIndices);
+    buildVertices(attrib, objIndices);
+    if (optimize) optimizeMesh();
+    indices = indexData.data();
+    indexCount = (int) indexData.size();
+    vertexCorners = vertexCornerData.data();
+    vertexCount = (int) vertexCornerData.size();
+    setVertexData(vertexData.data());
+    materialIds = materialIdData.data();
+    
+    tangentData.resize(indexCount/3);
+    calcTangents();
+    tangents = tangentData.data();
+}
+
+void Model::setVertexData(const float *data) {
+    if (layout == VERTEX_INTERLEAVED) {
+        positions = data;
+        normals = data + 3;
+        texcoords = data + 6;
+        positionStride = normalStride = texcoordStride = 8;
+    } else {
+        positions = data;
+        normals = data + 3*vertexCount;
+        texcoords = data + 6*vertexCount;
+        positionStride = 3;
+        normalStride = 3;
+        texcoordStride = 2;
+    }
+}
+
+bool Model::loadCache(const std::string &cachefile, const std::string &inputfile) {
+    if (!cache.open(cachefile, inputfile, cacheFlags())) return false;
+    
+    size_t n, faces, floats;
+    indices = cache.get<uint32_t>(MeshCache::MESH_INDICES, n);
+    indexCount = (int) n;
+    vertexCorners = cache.get<int>(MeshCache::MESH_VERTEX_CORNERS, n);
+    vertexCount = (int) n;
+    const float *data = cache.get<float>(MeshCache::MESH_VERTICES, floats);
+    tangents = cache.get<vector3>(MeshCache::MESH_TANGENTS, faces);
+    materialIds = cache.get<int>(MeshCache::MESH_MATERIAL_IDS, n);
+    if (floats != 8*(size_t)vertexCount || faces != (size_t)indexCount/3 || n != faces) {
+        cache.close();
+        return false;
+    }
+    setVertexData(data);
+    
+    //names are NUL terminated, a material's strings follow each other
+    materials.clear();
+    const char *str = cache.get<char>(MeshCache::MESH_MATERIALS, n);
+    const char *end = str + n;
+    while (str < end) {
+        std::string fields[MeshCache::MATERIAL_STRINGS];
+        for (int k = 0; k < MeshCache::MATERIAL_STRINGS && str < end; k++) {
+            fields[k] = std::string(str, strnlen(str, end - str));
+            str += fields[k].size() + 1;
+        }
+        ModelMaterial m;
+        m.name = fields[0];
+        m.diffuse = fields[1];
+        m.normal = fields[2];
+        m.specular = fields[3];
+        materials.push_back(m);
+    }
+    return true;
+}
+
+bool Model::saveCache(const std::string &cachefile, const std::string &inputfile) {
+    std::string strings;
+    for (size_t i = 0; i < materials.size(); i++) {
+        const ModelMaterial &m = materials[i];
+        strings += m.name + '\0' + m.diffuse + '\0' + m.normal + '\0' + m.specular + '\0';
+    }
+    
+    const void *sections[MeshCache::SECTION_COUNT];
+    size_t bytes[MeshCache::SECTION_COUNT];
+    sections[MeshCache::MESH_VERTICES] = vertexData.data();
+    bytes[MeshCache::MESH_VERTICES] = vertexData.size() * sizeof(float);
+    sections[MeshCache::MESH_INDICES] = indexData.data();
+    bytes[MeshCache::MESH_INDICES] = indexData.size() * sizeof(uint32_t);
+    sections[MeshCache::MESH_VERTEX_CORNERS] = vertexCornerData.data();
+    bytes[MeshCache::MESH_VERTEX_CORNERS] = vertexCornerData.size() * sizeof(int);
+    sections[MeshCache::MESH_TANGENTS] = tangentData.data();
+    bytes[MeshCache::MESH_TANGENTS] = tangentData.size() * sizeof(vector3);
+    sections[MeshCache::MESH_MATERIAL_IDS] = materialIdData.data();
+    bytes[MeshCache::MESH_MATERIAL_IDS] = materialIdData.size() * sizeof(int);
+    sections[MeshCache::MESH_MATERIALS] = strings.data();
+    bytes[MeshCache::MESH_MATERIALS] = strings.size();
+    
+    return MeshCache::write(cachefile, inputfile, materialFiles, cacheFlags(), sections, bytes);
+}
+
+//The diffuse, normal and specular files of a material, each either the name
+//in the material, relative to the OBJ, or the one derived from the OBJ's.
+void Model::textureFiles(const std::string &inputfile, int material, std::string files[3]) {
+    static const char *suffixes[3] = {"_diffuse.tga", "_nm_tangent.tga", "_spec.tga"};
+    std::string basedir = inputfile.substr(0, inputfile.find_last_of("/") + 1);
+    std::string stem = inputfile.substr(0, inputfile.find_last_of("."));
+    for (int i = 0; i < 3; i++) {
+        std::string name;
+        if (material >= 0) {
+            const ModelMaterial &m = materials[material];
+            name = i == 0 ? m.diffuse : i == 1 ? m.normal : m.specular;
+        }
+        files[i] = name.empty() ? stem + suffixes[i] : basedir + name;
+    }
+}
+
+//Stable sort of the faces by material, the materials ordered by their
+//texture files so the ones sharing textures end up next to each other.
+void Model::groupFaces(const std::string &inputfile, std::vector<tinyobj::index_t> &objIndices) {
+    int count = (int) materials.size();
+    std::vector<std::string> keys(count + 1);
+    for (int m = -1; m < count; m++) {
+        std::string files[3];
+        textureFiles(inputfile, m, files);
+        keys[m + 1] = files[0] + '\n' + files[1] + '\n' + files[2];
+    }
+    std::vector<int> order(count + 1), rank(count + 1);
+    for (int m = 0; m <= count; m++) order[m] = m;
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) {return keys[a] < keys[b];});
+    for (int i = 0; i <= count; i++) rank[order[i]] = i;
+    
+    int faceCount = (int) materialIdData.size();
+    std::vector<int> faces(faceCount);
+    for (int f = 0; f < faceCount; f++) faces[f] = f;
+    std::stable_sort(faces.begin(), faces.end(), [&](int a, int b) {
+        return rank[materialIdData[a] + 1] < rank[materialIdData[b] + 1];
+    });
+    
+    std::vector<tinyobj::index_t> sortedIndices(objIndices.size());
+    std::vector<int> sortedIds(faceCount);
+    for (int f = 0; f < faceCount; f++) {
+        for (int k = 0; k < 3; k++) sortedIndices[3*f + k] = objIndices[3*faces[f] + k];
+        sortedIds[f] = materialIdData[faces[f]];
+    }
+    objIndices.swap(sortedIndices);
+    materialIdData.swap(sortedIds);
+}
+
+//One batch per run of faces with the same material, and one set of textures
+//per distinct set of files.
+void Model::buildBatches(const std::string &inputfile) {
+    batches.clear();
+    int faceCount = indexCount/3;
+    for (int start = 0; start < faceCount;) {
+        int end = start + 1;
+        while (end < faceCount && materialIds[end] == materialIds[start]) end++;
+        ModelBatch batch;
+        batch.material = materialIds[start];
+        batch.firstFace = start;
+        batch.faceCount = end - start;
+        batch.textures = NULL;
+        batches.push_back(batch);
+        start = end;
+    }
+    
+    //a model without faces still binds the default textures
+    int count = std::max((int) batches.size(), 1);
+    std::vector<int> batchSets(count);
+    std::map<std::string, int> sets;
+    textureSets.clear();
+    for (int b = 0; b < count; b++) {
+        std::string files[3];
+        textureFiles(inputfile, batches.empty() ? -1 : batches[b].material, files);
+        std::string key = files[0] + '\n' + files[1] + '\n' + files[2];
+        auto it = sets.find(key);
+        if (it == sets.end()) {
+            it = sets.insert(std::make_pair(key, (int) textureSets.size())).first;
+            MaterialTextures t;
+            t.diffuse = TextureCache::shared().load<ColorTexel>(files[0]);
+            t.normal = TextureCache::shared().load<NormalTexel>(files[1]);
+            t.specular = TextureCache::shared().load<ScalarTexel>(files[2]);
+            textureSets.push_back(t);
+        }
+        batchSets[b] = it->second;
+    }
+    for (size_t b = 0; b < batches.size(); b++) batches[b].textures = &textureSets[batchSets[b]];
+    bound = &textureSets[batchSets[0]];
+}
+
+struct IndexHash {
+    size_t operator()(const tinyobj::index_t &i) const {
+        return ((size_t)i.vertex_index * 73856093) ^ ((size_t)i.normal_index * 19349663) ^ ((size_t)i.texcoord_index * 83492791);
+    }
+};
+
+struct IndexEqual {
+    bool operator()(const tinyobj::index_t &a, const tinyobj::index_t &b) const {
+        return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index && a.texcoord_index == b.texcoord_index;
+    }
+};
+
+//Runs the three MeshOptimizer passes over the built buffers, the face passes
+//within each material's run of faces so they stay grouped, and reports the
+//average cache miss ratio of a 16 entry FIFO before and after.
+void Model::optimizeMesh() {
+    int count = (int) vertexCornerData.size();
+    int faceCount = (int) indexData.size()/3;
+    float before = MeshOptimizer::acmr(indexData, count);
+    
+    std::vector<int> runs;
+    for (int f = 0; f < faceCount; f++) {
+        if (f == 0 || materialIdData[f] != materialIdData[f - 1]) runs.push_back(f);
+    }
+    runs.push_back(faceCount);
+    
+    //the material ids of a run are all the same, so only the indices move
+    float cached = 0.0f;
+    int clusters = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t r = 0; r + 1 < runs.size(); r++) {
+            std::vector<uint32_t> run(indexData.begin() + 3*runs[r], indexData.begin() + 3*runs[r + 1]);
+            if (pass == 0) MeshOptimizer::vertexCache(run, count);
+            else clusters += MeshOptimizer::overdraw(run, vertexData.data(), layout == VERTEX_INTERLEAVED ? 8 : 3);
+            std::copy(run.begin(), run.end(), indexData.begin() + 3*runs[r]);
+        }
+        if (pass == 0) cached = MeshOptimizer::acmr(indexData, count);
+    }
+    float after = MeshOptimizer::acmr(indexData, count);
+    
+    std::vector<int> remap;
+    MeshOptimizer::vertexFetch(indexData, count, remap);
+    std::vector<float> sorted(vertexData.size());
+    for (int v = 0; v < count; v++) {
+        int to = remap[v];
+        if (layout == VERTEX_INTERLEAVED) {
+            std::copy(&vertexData[8*v], &vertexData[8*v] + 8, &sorted[8*to]);
+        } else {
+            std::copy(&vertexData[3*v], &vertexData[3*v] + 3, &sorted[3*to]);
+            std::copy(&vertexData[3*count + 3*v], &vertexData[3*count + 3*v] + 3, &sorted[3*count + 3*to]);
+            std::copy(&vertexData[6*count + 2*v], &vertexData[6*count + 2*v] + 2, &sorted[6*count + 2*to]);
+        }
+    }
+    vertexData.swap(sorted);
+    for (int i = (int) indexData.size() - 1; i >= 0; i--) vertexCornerData[indexData[i]] = i;
+    
+    std::cout << "optimize mesh ACMR " << before << " -> " << cached << " vertex cache, "
+              << after << " in " << clusters << " overdraw clusters" << std::endl;
+}
+
+//One vertex per distinct index triple, in order of first use. A missing
+//normal or texcoord reads as zeros.
+void Model::buildVertices(const tinyobj::attrib_t &attrib, const std::vector<tinyobj::index_t> &objIndices) {
+    std::unordered_map<tinyobj::index_t, int, IndexHash, IndexEqual> ids;
+    indexData.resize(objIndices.size());
+    vertexCornerData.clear();
+    for (size_t i = 0; i < objIndices.size(); i++) {
+        auto it = ids.find(objIndices[i]);
+        if (it == ids.end()) {
+            it = ids.insert(std::make_pair(objIndices[i], (int)vertexCornerData.size())).first;
+            vertexCornerData.push_back((int)i);
+        }
+        indexData[i] = (uint32_t)it->second;
+    }
+    
+    int count = (int) vertexCornerData.size();
+    vertexData.assign(8*(size_t)count, 0.0f);
+    for (int v = 0; v < count; v++) {
+        const tinyobj::index_t &idx = objIndices[vertexCornerData[v]];
+        float *position, *normal, *uv;
+        if (layout == VERTEX_INTERLEAVED) {
+            position = &vertexData[8*v];
+            normal = position + 3;
+            uv = position + 6;
+        } else {
+            position = &vertexData[3*v];
+            normal = &vertexData[3*count + 3*v];
+            uv = &vertexData[6*count + 2*v];
+        }
+        for (int k = 0; k < 3; k++) position[k] = attrib.vertices[3*idx.vertex_index + k];
+        if (idx.normal_index >= 0) {
+            for (int k = 0; k < 3; k++) normal[k] = attrib.normals[3*idx.normal_index + k];
+        }
+        if (idx.texcoord_index >= 0) {
+            for (int k = 0; k < 2; k++) uv[k] = attrib.texcoords[2*idx.texcoord_index + k];
+        }
     }
 }
 
 void Model::calcTangents() {
     for (int f = 0; f < getIndexSize()/3; f++) {
         
-        tinyobj::index_t idx1 = getIndex(f, 0);
-        vector3 pos1 = getVertex(idx1.vertex_index);
-        vector2 uv1 = getUV(idx1.texcoord_index);
+        int v1 = getIndex(f, 0);
+        vector3 pos1 = getVertex(v1);
+        vector2 uv1 = getUV(v1);
         
-        tinyobj::index_t idx2 = getIndex(f, 1);
-        vector3 pos2 = getVertex(idx2.vertex_index);
-        vector2 uv2 = getUV(idx2.texcoord_index);
+        int v2 = getIndex(f, 1);
+        vector3 pos2 = getVertex(v2);
+        vector2 uv2 = getUV(v2);
         
-        tinyobj::index_t idx3 = getIndex(f, 2);
-        vector3 pos3 = getVertex(idx3.vertex_index);
-        vector2 uv3 = getUV(idx3.texcoord_index);
+        int v3 = getIndex(f, 2);
+        vector3 pos3 = getVertex(v3);
+        vector2 uv3 = getUV(v3);
         
         vector3 edge1 = pos2-pos1;
         vector3 edge2 = pos3-pos1;
@@ -143,7 +605,7 @@ void Model::calcTangents() {
         bitangent.z = ff * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
         bitangent.normalize();
         
-        tangents[f] = tangent;
+        tangentData[f] = tangent;
     }
 }
 
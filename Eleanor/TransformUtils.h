@@ -9,6 +9,8 @@
 #ifndef TransformUtils_h
 #define TransformUtils_h
 
+#include <cmath>
+
 #include "math/math.h"
 
 matrix44 viewport(int x, int y, int w, int h) {
@@ -52,6 +54,7 @@ matrix44 projection(float coeff) {
     return projection;
 }
 
+//far can be INFINITY
 matrix44 projectionFOV(float fovy, float aspect, float near, float far) {
     matrix44 m;
     float d2r = PI/180.0f;
@@ -59,8 +62,13 @@ matrix44 projectionFOV(float fovy, float aspect, float near, float far) {
     float tanHalfFovy = (float)tan(d2r * fovy/2.0f);
     m.m[0][0] = 1.0f / (aspect * tanHalfFovy);
     m.m[1][1] = 1.0f / tanHalfFovy;
-    m.m[2][2] = (near+far)/nmf;
-    m.m[2][3] = 2*far*near/nmf;
+    if (std::isinf(far)) {
+        m.m[2][2] = -1.0f;
+        m.m[2][3] = -2.0f*near;
+    } else {
+        m.m[2][2] = (near+far)/nmf;
+        m.m[2][3] = 2*far*near/nmf;
+    }
     m.m[3][2] = -1.0f;
 
     m.m[3][3] = 0.0f;
@@ -0,0 +1,145 @@
+//
+//  bench.cpp
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+#include "benchmark.h"
+
+static void usage(const char *name) {
+    std::cerr << "usage: " << name << " [options] [model.obj ...]" << std::endl
+              << "  -n frames     frames per orbit (60)" << std::endl
+              << "  -size WxH     add a resolution, repeatable (320x240 800x600 1920x1080)" << std::endl
+              << "  -t threads    raster threads (hardware concurrency)" << std::endl
+              << "  -json file    write the results as JSON" << std::endl
+              << "  --selftest    check the batched point transform against the scalar one and exit" << std::endl
+              << "  --dispatch    time each shader through IShader and through its concrete type, on the" << std::endl
+              << "                first model at the first resolution (800x600), -n frames (50), and exit" << std::endl
+              << "  --math        time Transforms::update and MVP * vertex over the first model's vertices" << std::endl
+              << "                and exit, build with and without NO_SIMD_MATH to compare" << std::endl
+              << "models default to the bundled african_head, floor and brickwall" << std::endl;
+}
+
+//the benchmarks of the viewer's opening view of one model
+static bool modelBenchmarks(const std::string &file, int w, int h, int threads, int frames, bool dispatch, bool math) {
+    //the loader has no way to report a missing file
+    if (!std::ifstream(file).good()) {
+        std::cerr << "cannot open file " << file << std::endl;
+        return false;
+    }
+    
+    Camera camera(vector3(2,2,10), vector3(0,1,0), -100, 0);
+    Model modelObj(file);
+    ModelNode modelNode;
+    modelNode.model = &modelObj;
+    modelNode.angle = 0.0f;
+    modelNode.position = vector3(0, 1, 0);
+    vector3 light = vector3(1,1,1);
+    light.normalize();
+    
+    Scene scene;
+    scene.camera = &camera;
+    scene.modelNode = &modelNode;
+    scene.light = &light;
+    
+    Benchmark benchmark(w, h, &scene);
+    benchmark.setThreads(threads);
+    if (math) benchmark.math(1000);
+    if (!dispatch) return true;
+    
+    TestShader test;
+    benchmark.dispatch("TestShader", test, frames);
+    PhongShader phong;
+    benchmark.dispatch("PhongShader", phong, frames);
+    TangentShader tangent;
+    benchmark.dispatch("TangentShader", tangent, frames);
+    TangentNormalShader tangentNormal;
+    benchmark.dispatch("TangentNormalShader", tangentNormal, frames);
+    TangentAShader tangentA;
+    benchmark.dispatch("TangentAShader", tangentA, frames);
+    return true;
+}
+
+int main(int argc, const char * argv[]) {
+
+    int frames = 60;
+    bool framesGiven = false;
+    int threads = 0;
+    bool dispatch = false;
+    bool math = false;
+    std::string jsonfile;
+    std::vector<std::string> models;
+    std::vector<std::pair<int, int> > resolutions;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-n" && hasValue) {
+            frames = atoi(argv[++i]);
+            framesGiven = true;
+        }
+        else if (arg == "-size" && hasValue) {
+            int w = 0, h = 0;
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            resolutions.push_back(std::make_pair(w, h));
+        }
+        else if (arg == "-t" && hasValue) threads = atoi(argv[++i]);
+        else if (arg == "-json" && hasValue) jsonfile = argv[++i];
+        else if (arg == "--selftest") return transformSelfTest() ? 0 : 1;
+        else if (arg == "--dispatch") dispatch = true;
+        else if (arg == "--math") math = true;
+        else if (arg[0] != '-') models.push_back(arg);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (dispatch || math) {
+        std::string file = models.empty() ? "obj/african_head/african_head.obj" : models[0];
+        int w = resolutions.empty() ? 800 : resolutions[0].first;
+        int h = resolutions.empty() ? 600 : resolutions[0].second;
+        if (!framesGiven) frames = 50;
+        if (frames < 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return modelBenchmarks(file, w, h, threads, frames, dispatch, math) ? 0 : 1;
+    }
+
+    if (frames < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (models.empty()) {
+        models.push_back("obj/african_head/african_head.obj");
+        models.push_back("obj/floor.obj");
+        models.push_back("obj/brickwall.obj");
+    }
+    if (resolutions.empty()) {
+        resolutions.push_back(std::make_pair(320, 240));
+        resolutions.push_back(std::make_pair(800, 600));
+        resolutions.push_back(std::make_pair(1920, 1080));
+    }
+
+    BenchmarkSuite suite(frames);
+    suite.setThreads(threads);
+    for (size_t i = 0; i < models.size(); i++) suite.addModel(models[i]);
+    for (size_t i = 0; i < resolutions.size(); i++) suite.addResolution(resolutions[i].first, resolutions[i].second);
+
+    suite.run();
+
+    if (!jsonfile.empty() && !suite.writeJSON(jsonfile)) return 1;
+    return 0;
+}
@@ -0,0 +1,466 @@
+//
+//  benchmark.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef benchmark_h
+#define benchmark_h
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <cstring>
+
+#include "softrenderer.h"
+#include "shaders.h"
+#include "scene.h"
+#include "camera.h"
+#include "headless.h"
+#include "TransformUtils.h"
+
+//Renders a scene offscreen, without a window, to time the renderer.
+class Benchmark {
+public:
+    Benchmark(int w, int h, Scene *s) : renderer(w, h), scene(s) {
+        width = w;
+        height = h;
+    }
+    
+    //threads of the renderer, 0 keeps the default
+    void setThreads(int n) {
+        if (n > 0) renderer.setThreads(n);
+    }
+    
+    //Time the same shader through the virtual IShader pipeline and through
+    //the pipeline compiled for its concrete type.
+    template <class Shader>
+    void dispatch(const char *name, Shader &shader, int frames);
+    
+    //Time the matrix and vector math on its own. Build once with and once
+    //without NO_SIMD_MATH to compare the two implementations.
+    void math(int iterations);
+
+private:
+    SoftRenderer renderer;
+    Scene *scene;
+    Transforms transforms;
+    int width, height;
+    
+    void setup(IShader &shader);
+    
+    template <class Shader>
+    double frameMs(Shader &shader, int frames);
+};
+
+void Benchmark::setup(IShader &shader) {
+    matrix44 rotate = rotateMatrix(0.0f, 1.0f, 0.0f, scene->modelNode->angle);
+    matrix44 translate = translateMatrix(scene->modelNode->position);
+    transforms.model = translate * rotate;
+    transforms.view = scene->camera->GetViewMatrix();
+    transforms.projection = projectionFOV(scene->camera->Zoom, (float)width/(float)height, 0.1f, 100.f);
+    transforms.update();
+    
+    renderer.setTransforms(&transforms);
+    
+    shader.modelObj = scene->modelNode->model;
+    shader.transforms = &transforms;
+    shader.light = scene->light;
+    shader.camera = scene->camera;
+}
+
+template <class Shader>
+double Benchmark::frameMs(Shader &shader, int frames) {
+    //warm up caches
+    renderer.clear();
+    renderer.model(*scene->modelNode->model, shader);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        renderer.clear();
+        renderer.model(*scene->modelNode->model, shader);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+template <class Shader>
+void Benchmark::dispatch(const char *name, Shader &shader, int frames) {
+    setup(shader);
+    
+    double virtualMs = frameMs(static_cast<IShader &>(shader), frames);
+    double staticMs = frameMs(shader, frames);
+    
+    std::cout << std::fixed << std::setprecision(2)
+              << name << ": virtual " << virtualMs << " ms"
+              << ", templated " << staticMs << " ms"
+              << ", speedup " << virtualMs / staticMs << "x" << std::endl;
+}
+
+void Benchmark::math(int iterations) {
+    Model *model = scene->modelNode->model;
+    Transforms t;
+    t.model = translateMatrix(scene->modelNode->position);
+    t.view = scene->camera->GetViewMatrix();
+    t.projection = projectionFOV(scene->camera->Zoom, (float)width/(float)height, 0.1f, 100.f);
+    
+    int count = model->getVertexCount();
+    std::vector<vector4> positions(count);
+    for (int i = 0; i < count; i++) {
+        positions[i] = vector4(model->getVertex(i), 1.0f);
+    }
+    
+    //accumulate every result so none of the work is optimized away
+    float sink = 0.0f;
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        t.model.m[0][3] = i * 1e-6f;
+        t.update();
+        sink += t.MVP_IT.m[0][0];
+    }
+    std::chrono::duration<double, std::nano> updateNs = std::chrono::steady_clock::now() - start;
+    
+    std::vector<vector4> transformed(count);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int k = 0; k < count; k++) {
+            transformed[k] = t.MVP * positions[k];
+        }
+        sink += transformed[i % count].w;
+    }
+    std::chrono::duration<double, std::nano> vertexNs = std::chrono::steady_clock::now() - start;
+    
+#ifdef SIMD_MATH
+    const char *variant = "SIMD";
+#else
+    const char *variant = "scalar";
+#endif
+    std::cout << std::fixed << std::setprecision(2)
+              << "math (" << variant << "): Transforms::update " << updateNs.count() / iterations << " ns"
+              << ", MVP * vertex " << vertexNs.count() / ((double)iterations * count) << " ns"
+              << " (" << sink << ")" << std::endl;
+}
+
+//Checks that matrix44::transform gives bit-identical results to operator *
+//and to the scalar expression both implement, over random matrices and
+//points, with w 1 and 0 and with and without the w output. The point count
+//leaves a partial SIMD tail. Run it from builds with and without
+//NO_SIMD_MATH. Prints the first mismatch and returns false.
+bool transformSelfTest(int points = 1027) {
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<float> x(points), y(points), z(points);
+    std::vector<float> out[4];
+    for (int r = 0; r < 4; r++) out[r].resize(points);
+    int checked = 0;
+    
+    for (int test = 0; test < 16; test++) {
+        matrix44 m;
+        for (int r = 0; r < 4; r++)
+            for (int k = 0; k < 4; k++)
+                m(r, k) = dist(rng);
+        for (int i = 0; i < points; i++) {
+            x[i] = dist(rng);
+            y[i] = dist(rng);
+            z[i] = dist(rng);
+        }
+        float w = test & 1 ? 0.0f : 1.0f;
+        bool withW = (test & 2) == 0;
+        m.transform(x.data(), y.data(), z.data(), w, out[0].data(), out[1].data(), out[2].data(), withW ? out[3].data() : NULL, points);
+        
+        for (int i = 0; i < points; i++) {
+            vector4 p = m * vector4(x[i], y[i], z[i], w);
+            for (int r = 0; r < (withW ? 4 : 3); r++) {
+                float scalar = m(r, 0)*x[i] + m(r, 1)*y[i] + m(r, 2)*z[i] + m(r, 3)*w;
+                float batched = out[r][i];
+                float single = p[r];
+                if (memcmp(&batched, &scalar, sizeof(float)) != 0 || memcmp(&single, &scalar, sizeof(float)) != 0) {
+                    std::cerr << std::setprecision(9) << "transform mismatch: test " << test << " point " << i << " row " << r
+                              << ": transform " << batched << ", operator * " << single << ", scalar " << scalar << std::endl;
+                    return false;
+                }
+                checked++;
+            }
+        }
+    }
+    
+#ifdef SIMD_MATH
+    const char *variant = "SIMD";
+#else
+    const char *variant = "scalar";
+#endif
+    std::cout << "transform self-test (" << variant << "): " << checked << " values bit-identical" << std::endl;
+    return true;
+}
+
+//one model, shader and resolution over a full orbit
+struct OrbitResult {
+    std::string model;
+    std::string shader;
+    int width, height;
+    int frames;
+    
+    //frame times in ms
+    double mean, median, p95, p99;
+    
+    double trianglesPerSec;     //submitted to the pipeline
+    double pixelsPerSec;        //fragments shaded
+    
+    //Mean time per frame of each stage alone, in ms summed over the raster
+    //threads, from the frames' RenderStats. Only measured with ELEANOR_PROFILE.
+    double vertexMs, setupMs, rasterMs, fragmentMs;
+};
+
+//Renders a scripted camera orbit around every model with every shader at
+//every resolution, headless, and reports frame time percentiles,
+//throughput and, with ELEANOR_PROFILE, the time of each stage. The path
+//only depends on the frame count and the model's bounds, so runs are
+//comparable across builds and machines.
+class BenchmarkSuite {
+public:
+    BenchmarkSuite(int f) {
+        frames = f;
+    }
+    
+    void addModel(const std::string &file) {
+        models.push_back(file);
+    }
+    
+    void addResolution(int w, int h) {
+        resolutions.push_back(std::make_pair(w, h));
+    }
+    
+    //threads of every renderer, 0 keeps the default
+    void setThreads(int n) {
+        threads = n;
+    }
+    
+    void run();
+    
+    bool writeJSON(const std::string &filename);
+    
+private:
+    int frames;
+    int threads = 0;
+    int usedThreads = 1;
+    std::vector<std::string> models;
+    std::vector<std::pair<int, int> > resolutions;
+    std::vector<OrbitResult> results;
+    
+    template <class Shader>
+    void orbit(Headless &headless, Scene &scene, const vector3 &center, float radius, const std::string &model, const char *shaderName);
+    
+    static double percentile(const std::vector<double> &sorted, double p);
+};
+
+double BenchmarkSuite::percentile(const std::vector<double> &sorted, double p) {
+    //nearest rank
+    size_t rank = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+template <class Shader>
+void BenchmarkSuite::orbit(Headless &headless, Scene &scene, const vector3 &center, float radius, const std::string &model, const char *shaderName) {
+    Shader shader;
+    SoftRenderer &renderer = headless.getRenderer();
+    
+    //30 degrees above the model, far enough for the 45 degree field of view
+    //to take in the bounding sphere. GetViewMatrix puts the eye one unit in
+    //front of Position, so step back one more.
+    const float elevation = 30.0f * DEG2RAD;
+    float distance = radius / sinf(22.5f * DEG2RAD) + 1.0f;
+    
+    std::vector<double> times;
+    long triangles = 0;
+    long pixels = 0;
+    double total = 0.0;
+    RenderStats stages;
+    
+    //the first frame warms up caches
+    for (int i = -1; i < frames; i++) {
+        float angle = 2.0f * PI * std::max(i, 0) / frames;
+        scene.camera->Position = center + vector3(cosf(angle) * cosf(elevation), sinf(elevation), sinf(angle) * cosf(elevation)) * distance;
+        scene.camera->LookAt(center);
+        
+        double ms = headless.render(shader, 1);
+        if (i < 0) continue;
+        
+        times.push_back(ms);
+        total += ms;
+        triangles += renderer.getStats().trianglesSubmitted;
+        pixels += renderer.getStats().fragmentsShaded;
+        stages.add(renderer.getStats());
+    }
+    std::sort(times.begin(), times.end());
+    
+    OrbitResult r;
+    r.model = model;
+    r.shader = shaderName;
+    r.width = renderer.getWidth();
+    r.height = renderer.getHeight();
+    r.frames = frames;
+    r.mean = total / frames;
+    r.median = percentile(times, 0.5);
+    r.p95 = percentile(times, 0.95);
+    r.p99 = percentile(times, 0.99);
+    r.trianglesPerSec = total > 0.0 ? triangles / (total / 1000.0) : 0.0;
+    r.pixelsPerSec = total > 0.0 ? pixels / (total / 1000.0) : 0.0;
+    r.vertexMs = stages.vertexNs / 1e6 / frames;
+    r.setupMs = stages.setupNs() / 1e6 / frames;
+    r.rasterMs = stages.rasterOnlyNs() / 1e6 / frames;
+    r.fragmentMs = stages.fragmentNs() / 1e6 / frames;
+    results.push_back(r);
+    
+    std::cout << std::fixed << std::setprecision(2)
+              << model << " " << shaderName << " " << r.width << "x" << r.height
+              << ": median " << r.median << " ms, p95 " << r.p95 << " ms, p99 " << r.p99 << " ms, "
+              << std::setprecision(1) << r.trianglesPerSec / 1e6 << " Mtris/s, "
+              << r.pixelsPerSec / 1e6 << " Mpx/s" << std::endl;
+#ifdef ELEANOR_PROFILE
+    std::cout << std::setprecision(2)
+              << "  vertex " << r.vertexMs << " ms, setup " << r.setupMs << " ms, raster " << r.rasterMs
+              << " ms, fragment " << r.fragmentMs << " ms (summed over threads)" << std::endl;
+#endif
+}
+
+void BenchmarkSuite::run() {
+    for (size_t m = 0; m < models.size(); m++) {
+        //the loader has no way to report a missing file
+        if (!std::ifstream(models[m]).good()) {
+            std::cerr << "skipping " << models[m] << ": cannot open file" << std::endl;
+            continue;
+        }
+        
+        Model modelObj(models[m]);
+        ModelNode modelNode;
+        modelNode.model = &modelObj;
+        modelNode.angle = 0.0f;
+        modelNode.position = vector3(0, 0, 0);
+        
+        //orbit the bounding box center at the bounding sphere's radius
+        vector3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+        for (int f = 0; f < modelObj.getIndexSize()/3; f++) {
+            for (int k = 0; k < 3; k++) {
+                vector3 v = modelObj.getVertex(modelObj.getIndex(f, k));
+                for (int c = 0; c < 3; c++) {
+                    lo[c] = std::min(lo[c], v[c]);
+                    hi[c] = std::max(hi[c], v[c]);
+                }
+            }
+        }
+        vector3 center = (lo + hi) * 0.5f;
+        vector3 half = (hi - lo) * 0.5f;
+        float radius = std::max(half.length(), 1e-3f);
+        
+        Camera camera;
+        vector3 light = vector3(1,1,1);
+        light.normalize();
+        
+        Scene scene;
+        scene.camera = &camera;
+        scene.modelNode = &modelNode;
+        scene.light = &light;
+        
+        for (size_t r = 0; r < resolutions.size(); r++) {
+            Headless headless(resolutions[r].first, resolutions[r].second);
+            headless.setScene(&scene);
+            if (threads > 0) headless.getRenderer().setThreads(threads);
+            usedThreads = headless.getRenderer().getThreads();
+            
+            orbit<TestShader>(headless, scene, center, radius, models[m], "TestShader");
+            orbit<PhongShader>(headless, scene, center, radius, models[m], "PhongShader");
+            orbit<TangentShader>(headless, scene, center, radius, models[m], "TangentShader");
+            orbit<TangentNormalShader>(headless, scene, center, radius, models[m], "TangentNormalShader");
+            orbit<TangentAShader>(headless, scene, center, radius, models[m], "TangentAShader");
+        }
+    }
+}
+
+static std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        out += s[i];
+    }
+    return out + "\"";
+}
+
+//stage times are null in builds that do not measure them
+static std::string jsonStage(double ms, bool profiled) {
+    if (!profiled) return "null";
+    std::ostringstream s;
+    s << std::setprecision(6) << ms;
+    return s.str();
+}
+
+bool BenchmarkSuite::writeJSON(const std::string &filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "cannot open file " << filename << std::endl;
+        return false;
+    }
+    
+#ifdef SIMD_MATH
+    const char *math = "SIMD";
+#else
+    const char *math = "scalar";
+#endif
+#ifdef SIMD_WIDTH
+    int simdWidth = SIMD_WIDTH;
+#else
+    int simdWidth = 1;
+#endif
+    
+#ifdef ELEANOR_PROFILE
+    bool profiled = true;
+#else
+    bool profiled = false;
+#endif
+    
+    out << std::setprecision(6);
+    out << "{" << std::endl;
+    out << "  \"math\": " << jsonString(math) << "," << std::endl;
+    out << "  \"simdWidth\": " << simdWidth << "," << std::endl;
+    out << "  \"threads\": " << usedThreads << "," << std::endl;
+    out << "  \"frames\": " << frames << "," << std::endl;
+    out << "  \"profiled\": " << (profiled ? "true" : "false") << "," << std::endl;
+    out << "  \"results\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const OrbitResult &r = results[i];
+        out << "    {\"model\": " << jsonString(r.model)
+            << ", \"shader\": " << jsonString(r.shader)
+            << ", \"width\": " << r.width
+            << ", \"height\": " << r.height
+            << ", \"frames\": " << r.frames
+            << ", \"meanMs\": " << r.mean
+            << ", \"medianMs\": " << r.median
+            << ", \"p95Ms\": " << r.p95
+            << ", \"p99Ms\": " << r.p99
+            << ", \"trianglesPerSec\": " << r.trianglesPerSec
+            << ", \"pixelsPerSec\": " << r.pixelsPerSec
+            << ", \"vertexMs\": " << jsonStage(r.vertexMs, profiled)
+            << ", \"setupMs\": " << jsonStage(r.setupMs, profiled)
+            << ", \"rasterMs\": " << jsonStage(r.rasterMs, profiled)
+            << ", \"fragmentMs\": " << jsonStage(r.fragmentMs, profiled)
+            << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+    
+    if (!out.good()) {
+        std::cerr << "cannot write json file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif /* benchmark_h */
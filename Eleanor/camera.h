@@ -65,6 +65,16 @@ public:
         return lookat(Position, Position+Front, Up);
     }
     
+    // Turn to face target, keeping the position
+    void LookAt(vector3 target) {
+        vector3 d = target - Position;
+        float len = sqrtf(d.x*d.x + d.y*d.y + d.z*d.z);
+        if (len == 0.0f) return;
+        Yaw = atan2f(d.z, d.x) / DEG2RAD;
+        Pitch = asinf(d.y / len) / DEG2RAD;
+        updateCameraVectors();
+    }
+    
     void ProcessKeyboard(Camera_Movement direction, float deltaTime) {
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
@@ -0,0 +1,147 @@
+//
+//  clipper.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef clipper_h
+#define clipper_h
+
+#include "math/math.h"
+#include "rasterizer.h"
+
+//a triangle clipped by all planes gains at most one vertex per plane
+const int CLIP_PLANES = 5;
+const int MAX_CLIP_VERTS = 3 + CLIP_PLANES;
+
+//Clip-space vertex of a clipped polygon. bc are its weights relative to the
+//three vertices of the source triangle, so shaders keep interpolating their
+//per-vertex varyings with barycentrics of the original face.
+struct ClipVertex {
+    vector4 pos;
+    vector3 bc;
+};
+
+//Sutherland-Hodgman clipping in homogeneous clip space against the near plane,
+//and against a guard band in x/y only where a triangle would leave the range
+//the fixed-point rasterizer can step. Everything inside the guard band is
+//left to the rasterizer's bounding box and scissor.
+struct Clipper {
+    float gx, gy;   //guard band in NDC units
+
+    void setViewport(int width, int height) {
+        //keep a few pixels clear of the limit so rounding stays in range
+        float band = GUARD_BAND - 16.0f;
+        gx = 2.0f*band/width - 1.0f;
+        gy = 2.0f*band/height - 1.0f;
+    }
+
+    //signed distance to a plane, inside when >= 0
+    float distance(const vector4 &p, int plane) {
+        switch (plane) {
+            case 0: return p.z + p.w;
+            case 1: return gx*p.w - p.x;
+            case 2: return gx*p.w + p.x;
+            case 3: return gy*p.w - p.y;
+            default: return gy*p.w + p.y;
+        }
+    }
+
+    int clipPlane(ClipVertex *in, int n, ClipVertex *out, int plane);
+
+    //Clip a triangle into a convex polygon, returns the number of vertices
+    //written to poly, 0 when nothing is left.
+    int clip(const vector4 *pts, ClipVertex *poly, bool &clipped);
+
+    //the polygon clip() returns for a triangle no plane cuts
+    static void unclipped(const vector4 *pts, ClipVertex *poly) {
+        for (int i = 0; i < 3; i++) {
+            poly[i].pos = pts[i];
+            poly[i].bc = vector3(i == 0, i == 1, i == 2);
+        }
+    }
+
+    //whether a polygon from clip() differs from its source triangle
+    static bool isClipped(const ClipVertex *poly, int n) {
+        return n != 3 || poly[0].bc.x != 1.0f || poly[1].bc.y != 1.0f || poly[2].bc.z != 1.0f;
+    }
+
+    //Clip a line segment to the view frustum, false when nothing is left.
+    bool clipLine(vector4 &a, vector4 &b);
+};
+
+int Clipper::clipPlane(ClipVertex *in, int n, ClipVertex *out, int plane) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        ClipVertex &a = in[i];
+        ClipVertex &b = in[(i+1)%n];
+        float da = distance(a.pos, plane);
+        float db = distance(b.pos, plane);
+
+        if (da >= 0) out[count++] = a;
+        if ((da >= 0) != (db >= 0)) {
+            float t = da / (da - db);
+            ClipVertex &v = out[count++];
+            for (int k = 0; k < 4; k++) v.pos[k] = a.pos[k] + (b.pos[k] - a.pos[k])*t;
+            for (int k = 0; k < 3; k++) v.bc[k] = a.bc[k] + (b.bc[k] - a.bc[k])*t;
+        }
+    }
+    return count;
+}
+
+int Clipper::clip(const vector4 *pts, ClipVertex *poly, bool &clipped) {
+    int planes = 0;
+    for (int p = 0; p < CLIP_PLANES; p++) {
+        for (int i = 0; i < 3; i++) {
+            if (distance(pts[i], p) < 0) planes |= 1 << p;
+        }
+    }
+
+    unclipped(pts, poly);
+    clipped = planes != 0;
+    if (!clipped) return 3;
+
+    ClipVertex tmp[MAX_CLIP_VERTS];
+    ClipVertex *in = poly;
+    ClipVertex *out = tmp;
+    int n = 3;
+    for (int p = 0; p < CLIP_PLANES && n >= 3; p++) {
+        if (!(planes & (1 << p))) continue;
+        n = clipPlane(in, n, out, p);
+        std::swap(in, out);
+    }
+    if (in != poly) {
+        for (int i = 0; i < n; i++) poly[i] = in[i];
+    }
+    return n >= 3 ? n : 0;
+}
+
+bool Clipper::clipLine(vector4 &a, vector4 &b) {
+    //Liang-Barsky against the near plane and the four side planes of the view
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int p = 0; p < 5; p++) {
+        float da, db;
+        switch (p) {
+            case 0: da = a.z + a.w; db = b.z + b.w; break;
+            case 1: da = a.w - a.x; db = b.w - b.x; break;
+            case 2: da = a.w + a.x; db = b.w + b.x; break;
+            case 3: da = a.w - a.y; db = b.w - b.y; break;
+            default: da = a.w + a.y; db = b.w + b.y; break;
+        }
+        if (da < 0 && db < 0) return false;
+        if (da < 0) t0 = std::max(t0, da / (da - db));
+        else if (db < 0) t1 = std::min(t1, da / (da - db));
+    }
+    if (t0 > t1) return false;
+
+    vector4 d(b.x - a.x, b.y - a.y, b.z - a.z, b.w - a.w);
+    vector4 na(a.x + d.x*t0, a.y + d.y*t0, a.z + d.z*t0, a.w + d.w*t0);
+    vector4 nb(a.x + d.x*t1, a.y + d.y*t1, a.z + d.z*t1, a.w + d.w*t1);
+    a = na;
+    b = nb;
+    return true;
+}
+
+#endif /* clipper_h */
@@ -0,0 +1,445 @@
+//
+//  framebuffer.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef framebuffer_h
+#define framebuffer_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <fstream>
+
+#include "TGAImage.h"
+#include "math/simd.h"
+
+//rows start on a cache line
+const int FRAME_ALIGN = 64;
+
+enum DepthFormat {
+    DEPTH_FLOAT32,
+    DEPTH_UNORM24,  //in the low bits of 32
+    DEPTH_UNORM16
+};
+
+//a fragment passes when (fragment depth) func (stored depth)
+enum DepthFunc {
+    DEPTH_NEVER,
+    DEPTH_LESS,
+    DEPTH_EQUAL,
+    DEPTH_LEQUAL,
+    DEPTH_GREATER,
+    DEPTH_NOTEQUAL,
+    DEPTH_GEQUAL,
+    DEPTH_ALWAYS
+};
+
+//Depths are clamped to [0,1] and compared as integer keys that order like the
+//depths: the unorm value, or the bits of the float, which sort like the float
+//for non-negative values. Keys of every format fit in a non-negative int.
+inline int depthKey(DepthFormat format, float z) {
+    z = z > 0.0f ? (z < 1.0f ? z : 1.0f) : 0.0f;
+    switch (format) {
+        case DEPTH_UNORM16: return (int)lrintf(z * 65535.0f);
+        case DEPTH_UNORM24: return (int)lrintf(z * 16777215.0f);
+        default: {
+            int key;
+            memcpy(&key, &z, sizeof(key));
+            return key;
+        }
+    }
+}
+
+//the same test with the depth axis flipped: less becomes greater and back
+inline DepthFunc mirrorDepthFunc(DepthFunc func) {
+    switch (func) {
+        case DEPTH_LESS: return DEPTH_GREATER;
+        case DEPTH_LEQUAL: return DEPTH_GEQUAL;
+        case DEPTH_GREATER: return DEPTH_LESS;
+        case DEPTH_GEQUAL: return DEPTH_LEQUAL;
+        default: return func;
+    }
+}
+
+inline bool depthPass(DepthFunc func, int z, int stored) {
+    switch (func) {
+        case DEPTH_NEVER: return false;
+        case DEPTH_LESS: return z < stored;
+        case DEPTH_EQUAL: return z == stored;
+        case DEPTH_LEQUAL: return z <= stored;
+        case DEPTH_GREATER: return z > stored;
+        case DEPTH_NOTEQUAL: return z != stored;
+        case DEPTH_GEQUAL: return z >= stored;
+        default: return true;
+    }
+}
+
+#ifdef SIMD_WIDTH
+//same as depthKey for every lane
+inline vint depthKeys(DepthFormat format, vfloat z) {
+    z = simdMin(simdMax(z, simdSet1(0.0f)), simdSet1(1.0f));
+    switch (format) {
+        case DEPTH_UNORM16: return simdRoundToInt(simdMul(z, simdSet1(65535.0f)));
+        case DEPTH_UNORM24: return simdRoundToInt(simdMul(z, simdSet1(16777215.0f)));
+        default: return simdCastToInt(z);
+    }
+}
+
+//bit i set when lane i passes
+inline unsigned int depthPassMask(DepthFunc func, vint z, vint stored) {
+    const unsigned int all = (1u << SIMD_WIDTH) - 1;
+    switch (func) {
+        case DEPTH_NEVER: return 0;
+        case DEPTH_LESS: return simdMaskGTInt(stored, z);
+        case DEPTH_EQUAL: return simdMaskEqInt(z, stored);
+        case DEPTH_LEQUAL: return ~simdMaskGTInt(z, stored) & all;
+        case DEPTH_GREATER: return simdMaskGTInt(z, stored);
+        case DEPTH_NOTEQUAL: return ~simdMaskEqInt(z, stored) & all;
+        case DEPTH_GEQUAL: return ~simdMaskGTInt(stored, z) & all;
+        default: return all;
+    }
+}
+#endif
+
+//state of a clear tile
+enum TileState {
+    TILE_CLEAN,     //holds the clear values
+    TILE_PENDING,   //must be cleared before it is read or written
+    TILE_DIRTY      //drawn to since it was cleared
+};
+
+//Color and depth planes of the renderer. Pixels are 32-bit BGRA in memory,
+//depth is stored in one of the DepthFormats and accessed as keys. Rows of
+//both planes go bottom-up and are pitch pixels apart.
+//clear() is lazy: it only marks the tiles that were drawn to, and a tile is
+//cleared when something first draws to it again or the frame is read. Tiles
+//nothing draws to are never cleared twice. Callers prepare() a rect before
+//writing it with the unchecked accessors, which is thread-safe as long as
+//threads write disjoint tiles.
+class FrameBuffer {
+public:
+    FrameBuffer(int w, int h, int tile, DepthFormat format = DEPTH_FLOAT32);
+    ~FrameBuffer();
+
+    //owns its planes
+    FrameBuffer(const FrameBuffer &) = delete;
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+
+    int getWidth() const {return width;}
+    int getHeight() const {return height;}
+    int getPitch() const {return pitch;}
+
+    uint32_t *getColor() {return color;}
+
+    DepthFormat getDepthFormat() const {return depthFormat;}
+    //reallocates the depth plane and clears the whole frame
+    void setDepthFormat(DepthFormat format);
+
+    int depthKey(float z) const {
+        return ::depthKey(depthFormat, z);
+    }
+#ifdef SIMD_WIDTH
+    vint depthKeys(vfloat z) const {
+        return ::depthKeys(depthFormat, z);
+    }
+#endif
+
+    //unchecked like setColor
+    int getDepthKey(int x, int y) const {
+        int i = x + y*pitch;
+        if (depthFormat == DEPTH_UNORM16) return ((const uint16_t *)depth)[i];
+        return ((const int32_t *)depth)[i];
+    }
+
+    void setDepthKey(int x, int y, int key) {
+        int i = x + y*pitch;
+        if (depthFormat == DEPTH_UNORM16) ((uint16_t *)depth)[i] = (uint16_t)key;
+        else ((int32_t *)depth)[i] = key;
+    }
+
+    static uint32_t pack(const TGAColor &c) {
+        uint32_t p;
+        memcpy(&p, c.bgra, sizeof(p));
+        return p;
+    }
+
+    //unchecked, the pixel must be inside a prepared rect
+    void setColor(int x, int y, uint32_t c) {
+        color[x + y*pitch] = c;
+    }
+
+    //checked, clears the pixel's tile first if it is pending
+    bool set(int x, int y, const TGAColor &c) {
+        if (x<0 || x>=width || y<0 || y>=height) return false;
+        prepare(x, y, x, y);
+        setColor(x, y, pack(c));
+        return true;
+    }
+
+    void clear(uint32_t c, float z);
+
+    //clear the pending tiles of the inclusive pixel rect and mark it drawn to
+    inline void prepare(int x0, int y0, int x1, int y1);
+
+    //clear every pending tile, call before reading the whole frame
+    void resolve();
+
+    //32-bit TGA written straight from the rows, TGA's default origin is bottom-left too
+    bool writeTGA(const char *filename);
+
+    //8-bit RGB PNG, top row first. The zlib stream uses stored blocks only, so
+    //it needs no compressor and is about the size of the raw pixels.
+    bool writePNG(const char *filename);
+
+private:
+    int width, height;
+    int pitch;
+    int tileSize;
+    int tilesX, tilesY;
+
+    uint32_t *colorData;
+    unsigned char *depthData = NULL;
+    uint32_t *color;
+    unsigned char *depth;
+    DepthFormat depthFormat;
+
+    uint32_t clearColor = 0;
+    float clearZ = 0.0f;
+    int clearDepth = 0;     //key of clearZ
+    std::vector<unsigned char> tiles;
+
+    void clearTile(int tile);
+
+    static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n);
+    static void writeChunk(std::ofstream &out, const char *type, const std::vector<unsigned char> &data);
+
+    template <class T>
+    static T *align(T *p) {
+        return (T *)(((uintptr_t)p + FRAME_ALIGN - 1) & ~(uintptr_t)(FRAME_ALIGN - 1));
+    }
+};
+
+FrameBuffer::FrameBuffer(int w, int h, int tile, DepthFormat format) {
+    width = w;
+    height = h;
+    tileSize = tile;
+
+    //a whole number of cache lines per row in every plane
+    const int rowPixels = FRAME_ALIGN / sizeof(uint16_t);
+    pitch = (width + rowPixels - 1) / rowPixels * rowPixels;
+
+    colorData = new uint32_t[pitch*height + FRAME_ALIGN/sizeof(uint32_t)];
+    color = align(colorData);
+
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    setDepthFormat(format);
+    resolve();
+}
+
+FrameBuffer::~FrameBuffer() {
+    delete [] colorData;
+    delete [] depthData;
+}
+
+void FrameBuffer::setDepthFormat(DepthFormat format) {
+    depthFormat = format;
+    int bytes = format == DEPTH_UNORM16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    delete [] depthData;
+    depthData = new unsigned char[pitch*height*bytes + FRAME_ALIGN];
+    depth = align(depthData);
+    clearDepth = depthKey(clearZ);
+    tiles.assign(tilesX * tilesY, TILE_PENDING);
+}
+
+void FrameBuffer::clear(uint32_t c, float z) {
+    int key = depthKey(z);
+    bool changed = c != clearColor || key != clearDepth;
+    clearColor = c;
+    clearZ = z;
+    clearDepth = key;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (changed || tiles[i] == TILE_DIRTY) tiles[i] = TILE_PENDING;
+    }
+}
+
+inline void FrameBuffer::prepare(int x0, int y0, int x1, int y1) {
+    for (int ty = y0 / tileSize; ty <= y1 / tileSize; ty++) {
+        for (int tx = x0 / tileSize; tx <= x1 / tileSize; tx++) {
+            int tile = tx + ty*tilesX;
+            if (tiles[tile] == TILE_PENDING) clearTile(tile);
+            tiles[tile] = TILE_DIRTY;
+        }
+    }
+}
+
+void FrameBuffer::resolve() {
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (tiles[i] == TILE_PENDING) {
+            clearTile((int)i);
+            tiles[i] = TILE_CLEAN;
+        }
+    }
+}
+
+void FrameBuffer::clearTile(int tile) {
+    int x0 = (tile % tilesX) * tileSize;
+    int y0 = (tile / tilesX) * tileSize;
+    int x1 = std::min(x0 + tileSize, width);
+    int y1 = std::min(y0 + tileSize, height);
+    for (int y = y0; y < y1; y++) {
+        std::fill(color + x0 + y*pitch, color + x1 + y*pitch, clearColor);
+        if (depthFormat == DEPTH_UNORM16) {
+            uint16_t *row = (uint16_t *)depth + y*pitch;
+            std::fill(row + x0, row + x1, (uint16_t)clearDepth);
+        } else {
+            int32_t *row = (int32_t *)depth + y*pitch;
+            std::fill(row + x0, row + x1, clearDepth);
+        }
+    }
+}
+
+bool FrameBuffer::writeTGA(const char *filename) {
+    resolve();
+
+    std::ofstream out;
+    out.open(filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "cannot open file " << filename << std::endl;
+        return false;
+    }
+
+    TGA_Header header;
+    memset(&header, 0, sizeof(header));
+    header.datatypecode = 2;
+    header.width = width;
+    header.height = height;
+    header.bitsperpixel = 32;
+    header.imagedescriptor = 8;     //alpha bits, bottom-left origin
+    out.write((char *)&header, sizeof(header));
+
+    for (int y = 0; y < height; y++) {
+        out.write((char *)(color + y*pitch), width*sizeof(uint32_t));
+    }
+    if (!out.good()) {
+        std::cerr << "cannot write tga file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FrameBuffer::writePNG(const char *filename) {
+    resolve();
+
+    std::ofstream out;
+    out.open(filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "cannot open file " << filename << std::endl;
+        return false;
+    }
+
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.write((const char *)signature, sizeof(signature));
+
+    std::vector<unsigned char> chunk;
+    auto put32 = [&chunk](uint32_t v) {
+        for (int k = 3; k >= 0; k--) chunk.push_back((unsigned char)(v >> (8*k)));
+    };
+
+    put32(width);
+    put32(height);
+    chunk.push_back(8);     //bit depth
+    chunk.push_back(2);     //truecolor
+    chunk.push_back(0);     //deflate
+    chunk.push_back(0);     //adaptive filtering
+    chunk.push_back(0);     //no interlace
+    writeChunk(out, "IHDR", chunk);
+
+    //filter type 0 then the RGB bytes of each row, from the top
+    std::vector<unsigned char> raw;
+    raw.reserve((size_t)(1 + width*3) * height);
+    for (int y = height - 1; y >= 0; y--) {
+        raw.push_back(0);
+        const unsigned char *p = (const unsigned char *)(color + y*pitch);
+        for (int x = 0; x < width; x++, p += 4) {
+            raw.push_back(p[2]);
+            raw.push_back(p[1]);
+            raw.push_back(p[0]);
+        }
+    }
+
+    chunk.clear();
+    chunk.push_back(0x78);  //deflate, 32K window
+    chunk.push_back(0x01);  //no dictionary, fastest level
+    uint32_t a = 1, b = 0;
+    size_t pos = 0;
+    bool last = false;
+    while (!last) {
+        size_t n = std::min(raw.size() - pos, (size_t)65535);
+        last = pos + n == raw.size();
+        chunk.push_back(last ? 1 : 0);
+        chunk.push_back((unsigned char)n);
+        chunk.push_back((unsigned char)(n >> 8));
+        chunk.push_back((unsigned char)~n);
+        chunk.push_back((unsigned char)(~n >> 8));
+        chunk.insert(chunk.end(), raw.begin() + pos, raw.begin() + pos + n);
+        for (size_t i = pos; i < pos + n; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += n;
+    }
+    put32((b << 16) | a);
+    writeChunk(out, "IDAT", chunk);
+
+    chunk.clear();
+    writeChunk(out, "IEND", chunk);
+
+    if (!out.good()) {
+        std::cerr << "cannot write png file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint32_t FrameBuffer::crc32(uint32_t crc, const unsigned char *data, size_t n) {
+    struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+    //built once, the initialization of a local static is thread-safe
+    static const Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void FrameBuffer::writeChunk(std::ofstream &out, const char *type, const std::vector<unsigned char> &data) {
+    unsigned char length[4];
+    uint32_t n = (uint32_t)data.size();
+    for (int k = 0; k < 4; k++) length[k] = (unsigned char)(n >> (24 - 8*k));
+    out.write((const char *)length, 4);
+    out.write(type, 4);
+    if (n > 0) out.write((const char *)data.data(), n);
+
+    uint32_t crc = crc32(0, (const unsigned char *)type, 4);
+    crc = crc32(crc, data.data(), n);
+    unsigned char tail[4];
+    for (int k = 0; k < 4; k++) tail[k] = (unsigned char)(crc >> (24 - 8*k));
+    out.write((const char *)tail, 4);
+}
+
+#endif /* framebuffer_h */
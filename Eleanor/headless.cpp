@@ -0,0 +1,186 @@
+//
+//  headless.cpp
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+#include "headless.h"
+#include "shaders.h"
+#include "scene.h"
+#include "camera.h"
+#include "ModelLoader.h"
+
+static void usage(const char *name) {
+    std::cerr << "usage: " << name << " [options] [model.obj]" << std::endl
+              << "  -o file       output image, .png or .tga (frame.png)" << std::endl
+              << "  -s shader     test, phong, tangent, tangentnormal or tangenta (phong)" << std::endl
+              << "  -n frames     frames to render (1)" << std::endl
+              << "  -size WxH     frame size (800x600)" << std::endl
+              << "  -t threads    raster threads (hardware concurrency)" << std::endl
+              << "  -c x,y,z      camera position (2,2,10)" << std::endl
+              << "  -look yaw,pitch  camera angles in degrees (-100,0)" << std::endl
+              << "  -a angle      model rotation about y in radians (0)" << std::endl
+              << "  -depth n      0 float32, 1 unorm24, 2 unorm16 (0)" << std::endl
+              << "  -f filter     nearest, bilinear or trilinear texture filtering (trilinear)" << std::endl
+              << "  -r            reversed-Z" << std::endl
+              << "  -v            visibility buffer" << std::endl
+              << "  -layout l     interleaved or soa vertex buffer (interleaved)" << std::endl
+              << "  -optimize     reorder the mesh for the vertex cache and less overdraw" << std::endl
+              << "  -nocache      parse the OBJ even if its mesh cache is up to date, and keep no cache" << std::endl
+              << "  -stats        print the pipeline counters of the last frame" << std::endl
+              << "  -trace file   write a Chrome trace, needs a build with ELEANOR_PROFILE" << std::endl;
+}
+
+static int malformed(const char *name, const std::string &option, const char *value) {
+    std::cerr << "malformed " << option << " " << value << std::endl;
+    usage(name);
+    return 1;
+}
+
+template <class Shader>
+static double render(Headless &headless, int frames) {
+    Shader shader;
+    return headless.render(shader, frames);
+}
+
+int main(int argc, const char * argv[]) {
+
+    std::string inputfile = "obj/african_head/african_head.obj";
+    std::string outputfile = "frame.png";
+    std::string shaderName = "phong";
+    int frames = 1;
+    int width = 800, height = 600;
+    int threads = 0;
+    vector3 position(2, 2, 10);
+    float yaw = -100.0f, pitch = 0.0f;
+    float angle = 0.0f;
+    int depthFormat = DEPTH_FLOAT32;
+    std::string filterName = "trilinear";
+    bool reversedZ = false;
+    bool visibility = false;
+    std::string layoutName = "interleaved";
+    bool optimize = false;
+    bool useCache = true;
+    bool printStats = false;
+    std::string tracefile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-o" && hasValue) outputfile = argv[++i];
+        else if (arg == "-s" && hasValue) shaderName = argv[++i];
+        else if (arg == "-n" && hasValue) frames = atoi(argv[++i]);
+        else if (arg == "-size" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) return malformed(argv[0], arg, argv[i]);
+        }
+        else if (arg == "-t" && hasValue) threads = atoi(argv[++i]);
+        else if (arg == "-c" && hasValue) {
+            if (sscanf(argv[++i], "%f,%f,%f", &position.x, &position.y, &position.z) != 3) return malformed(argv[0], arg, argv[i]);
+        }
+        else if (arg == "-look" && hasValue) {
+            if (sscanf(argv[++i], "%f,%f", &yaw, &pitch) != 2) return malformed(argv[0], arg, argv[i]);
+        }
+        else if (arg == "-a" && hasValue) angle = (float)atof(argv[++i]);
+        else if (arg == "-depth" && hasValue) depthFormat = atoi(argv[++i]);
+        else if (arg == "-f" && hasValue) filterName = argv[++i];
+        else if (arg == "-r") reversedZ = true;
+        else if (arg == "-v") visibility = true;
+        else if (arg == "-layout" && hasValue) layoutName = argv[++i];
+        else if (arg == "-optimize") optimize = true;
+        else if (arg == "-nocache") useCache = false;
+        else if (arg == "-stats") printStats = true;
+        else if (arg == "-trace" && hasValue) tracefile = argv[++i];
+        else if (arg[0] != '-') inputfile = arg;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width <= 0 || height <= 0 || frames < 1 || depthFormat < 0 || depthFormat > DEPTH_UNORM16) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    //the loader has no way to report a missing file
+    if (!std::ifstream(inputfile).good()) {
+        std::cerr << "cannot open file " << inputfile << std::endl;
+        return 1;
+    }
+
+    Camera camera(position, vector3(0,1,0), yaw, pitch);
+
+    Scene scene;
+    scene.camera = &camera;
+
+    TextureFilter filter;
+    if (filterName == "nearest") filter = FILTER_NEAREST;
+    else if (filterName == "bilinear") filter = FILTER_BILINEAR;
+    else if (filterName == "trilinear") filter = FILTER_TRILINEAR;
+    else {
+        std::cerr << "unknown filter " << filterName << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    VertexLayout layout;
+    if (layoutName == "interleaved") layout = VERTEX_INTERLEAVED;
+    else if (layoutName == "soa") layout = VERTEX_SOA;
+    else {
+        std::cerr << "unknown vertex layout " << layoutName << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    Model modelObj(inputfile, useCache, layout, optimize);
+    modelObj.setTextureFilter(filter);
+    ModelNode modelNode;
+    modelNode.model = &modelObj;
+    modelNode.angle = angle;
+    modelNode.position = vector3(0, 1, 0);
+
+    scene.modelNode = &modelNode;
+
+    vector3 light = vector3(1,1,1);
+    light.normalize();
+    scene.light = &light;
+
+    Headless headless(width, height);
+    headless.setScene(&scene);
+
+    SoftRenderer &renderer = headless.getRenderer();
+    if (threads > 0) renderer.setThreads(threads);
+    renderer.setDepthFormat((DepthFormat)depthFormat);
+    renderer.enableVisibilityBuffer(visibility);
+    headless.setReversedZ(reversedZ);
+
+    double ms;
+    if (shaderName == "test") ms = render<TestShader>(headless, frames);
+    else if (shaderName == "phong") ms = render<PhongShader>(headless, frames);
+    else if (shaderName == "tangent") ms = render<TangentShader>(headless, frames);
+    else if (shaderName == "tangentnormal") ms = render<TangentNormalShader>(headless, frames);
+    else if (shaderName == "tangenta") ms = render<TangentAShader>(headless, frames);
+    else {
+        std::cerr << "unknown shader " << shaderName << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << shaderName << " " << width << "x" << height << ": " << frames << " frames, "
+              << ms << " ms/frame" << std::endl;
+
+    if (printStats) renderer.getStats().dump();
+    if (!tracefile.empty() && !renderer.writeTrace(tracefile)) return 1;
+
+    return headless.save(outputfile) ? 0 : 1;
+}
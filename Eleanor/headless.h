@@ -0,0 +1,105 @@
+//
+//  headless.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef headless_h
+#define headless_h
+
+#include <string>
+#include <chrono>
+#include <cmath>
+
+#include "softrenderer.h"
+#include "shaders.h"
+#include "scene.h"
+#include "TransformUtils.h"
+
+//Renders a scene into an offscreen SoftRenderer and writes the frame to an
+//image file. The windowless counterpart of Viewer: no SDL, no vsync, so it
+//runs on machines without a display and is what throughput is measured with.
+class Headless {
+public:
+    Headless(int w, int h) : renderer(w, h) {
+        width = w;
+        height = h;
+    }
+
+    void setScene(Scene *s) {
+        scene = s;
+    }
+
+    SoftRenderer &getRenderer() {return renderer;}
+    Transforms &getTransforms() {return transforms;}
+
+    //reversed-Z goes with an infinite far plane, as in the viewer
+    void setReversedZ(bool r) {
+        far = r ? INFINITY : 100.f;
+        renderer.setReversedZ(r, near, far);
+    }
+
+    //Clear and draw the scene frames times with shader, returns the mean
+    //milliseconds per frame. Pass the concrete shader to time the pipeline
+    //compiled for it, or an IShader reference for the virtual one.
+    template <class Shader>
+    double render(Shader &shader, int frames = 1);
+
+    //the format follows the extension, .png or .tga
+    bool save(const std::string &filename);
+
+private:
+    SoftRenderer renderer;
+    Scene *scene = NULL;
+    Transforms transforms;
+    int width, height;
+    float near = 0.1f;
+    float far = 100.f;
+
+    void setup(IShader &shader);
+};
+
+void Headless::setup(IShader &shader) {
+    matrix44 rotate = rotateMatrix(0.0f, 1.0f, 0.0f, scene->modelNode->angle);
+    matrix44 translate = translateMatrix(scene->modelNode->position);
+    transforms.model = translate * rotate;
+    transforms.view = scene->camera->GetViewMatrix();
+    transforms.projection = projectionFOV(scene->camera->Zoom, (float)width/(float)height, near, far);
+    transforms.update();
+
+    renderer.setTransforms(&transforms);
+
+    shader.modelObj = scene->modelNode->model;
+    shader.transforms = &transforms;
+    shader.light = scene->light;
+    shader.camera = scene->camera;
+}
+
+template <class Shader>
+double Headless::render(Shader &shader, int frames) {
+    setup(shader);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        renderer.clear();
+        renderer.model(*scene->modelNode->model, shader);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return frames > 0 ? elapsed.count() / frames : 0.0;
+}
+
+bool Headless::save(const std::string &filename) {
+    size_t dot = filename.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : filename.substr(dot + 1);
+    for (size_t i = 0; i < ext.size(); i++) ext[i] = (char)tolower(ext[i]);
+
+    FrameBuffer &frame = renderer.getFrameBuffer();
+    if (ext == "png") return frame.writePNG(filename.c_str());
+    if (ext == "tga") return frame.writeTGA(filename.c_str());
+    std::cerr << "unknown image format " << filename << ", use .png or .tga" << std::endl;
+    return false;
+}
+
+#endif /* headless_h */
@@ -0,0 +1,105 @@
+//
+//  hizbuffer.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef hizbuffer_h
+#define hizbuffer_h
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+#include "framebuffer.h"
+
+const int HIZ_SHIFT = 3;
+const int HIZ_BLOCK = 1 << HIZ_SHIFT;
+
+//Coarse depth buffer holding the farthest depth of every 8x8 block of the
+//zbuffer. A triangle whose nearest depth is behind a block's max cannot pass
+//the depth test anywhere in that block.
+//It works on the frame's depth keys, negated when the depth test passes
+//greater depths, so that nearer is always smaller here.
+//Blocks never straddle a raster tile, so workers can update it without locking.
+struct HiZBuffer {
+    int *maxz = NULL;
+    char *dirty = NULL;
+    int bw, bh;
+    
+    void init(int width, int height) {
+        bw = (width + HIZ_BLOCK - 1) >> HIZ_SHIFT;
+        bh = (height + HIZ_BLOCK - 1) >> HIZ_SHIFT;
+        maxz = new int[bw*bh];
+        dirty = new char[bw*bh];
+        memset(dirty, 0, bw*bh);
+    }
+    
+    void release() {
+        delete [] maxz;
+        delete [] dirty;
+        maxz = NULL;
+        dirty = NULL;
+    }
+    
+    void clear(int z) {
+        for (int i = 0; i < bw*bh; i++) maxz[i] = z;
+    }
+    
+    int block(int x, int y) {
+        return (x >> HIZ_SHIFT) + (y >> HIZ_SHIFT)*bw;
+    }
+    
+    bool occluded(int x, int y, int zmin) {
+        return zmin > maxz[block(x, y)];
+    }
+    
+    //remember that a depth in this block changed, list is per worker
+    void touch(int x, int y, std::vector<int> &list) {
+        int b = block(x, y);
+        if (!dirty[b]) {
+            dirty[b] = 1;
+            list.push_back(b);
+        }
+    }
+    
+    //count blocks of the pixel rect that zmin cannot pass
+    int occludedBlocks(int minX, int minY, int maxX, int maxY, int zmin, int &total) {
+        int count = 0;
+        total = 0;
+        for (int by = minY >> HIZ_SHIFT; by <= maxY >> HIZ_SHIFT; by++) {
+            for (int bx = minX >> HIZ_SHIFT; bx <= maxX >> HIZ_SHIFT; bx++) {
+                total++;
+                if (zmin > maxz[bx + by*bw]) count++;
+            }
+        }
+        return count;
+    }
+    
+    //recompute the max of every block touched since the last update
+    void update(const FrameBuffer &frame, bool negate, std::vector<int> &list) {
+        int width = frame.getWidth();
+        int height = frame.getHeight();
+        for (size_t i = 0; i < list.size(); i++) {
+            int b = list[i];
+            int x0 = (b % bw) << HIZ_SHIFT;
+            int y0 = (b / bw) << HIZ_SHIFT;
+            int x1 = std::min(x0 + HIZ_BLOCK, width);
+            int y1 = std::min(y0 + HIZ_BLOCK, height);
+            int m = INT_MIN;
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    int z = frame.getDepthKey(x, y);
+                    m = std::max(m, negate ? -z : z);
+                }
+            }
+            maxz[b] = m;
+            dirty[b] = 0;
+        }
+        list.clear();
+    }
+};
+
+#endif /* hizbuffer_h */
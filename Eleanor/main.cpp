@@ -28,9 +28,6 @@ std::string inputfile = "obj/african_head/african_head.obj";
 
 int main(int argc, const char * argv[]) {
     
-    Viewer viewer(SCREEN_WIDTH, SCREEN_HEIGHT);
-    viewer.init();
-    
     Camera camera(vector3(2,2,10), vector3(0,1,0), -100, 0);
     
     Scene scene;
@@ -48,6 +45,9 @@ int main(int argc, const char * argv[]) {
     light.normalize();
     scene.light = &light;
     
+    Viewer viewer(SCREEN_WIDTH, SCREEN_HEIGHT);
+    viewer.init();
+    
     viewer.setScene(&scene);
     
     
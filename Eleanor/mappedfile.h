@@ -0,0 +1,74 @@
+//
+//  mappedfile.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef mappedfile_h
+#define mappedfile_h
+
+#include <cstddef>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//A whole file mapped read-only for as long as the object lives
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() {close();}
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    //an empty file opens with no data
+    bool open(const std::string &filename);
+    void close();
+
+    bool isOpen() const {return opened;}
+    const char *data() const {return (const char *)ptr;}
+    size_t size() const {return length;}
+
+private:
+    void *ptr = NULL;
+    size_t length = 0;
+    bool opened = false;
+};
+
+bool MappedFile::open(const std::string &filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        ptr = p;
+        length = (size_t)st.st_size;
+    }
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr) munmap(ptr, length);
+    ptr = NULL;
+    length = 0;
+    opened = false;
+}
+
+#endif /* mappedfile_h */
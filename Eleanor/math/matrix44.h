@@ -9,8 +9,20 @@
 #ifndef matrix44_h
 #define matrix44_h
 
+#include <cstring>
+
+#include "simd.h"
+
+//Row-major, with each row 16-byte aligned so SIMD_MATH can load it into one
+//register. The SIMD variant runs the same multiplies and adds in the same
+//order as the scalar one, except inverse() which takes the adjugate instead
+//of eliminating and may differ in the last bits.
 struct matrix44 {
+#ifdef SIMD_MATH
+    alignas(16) float m[4][4];
+#else
     float m[4][4];
+#endif
     
     matrix44();
     matrix44(const matrix44 &mm);
@@ -23,6 +35,13 @@ struct matrix44 {
     vector4 operator *(const vector4 &vv);
     matrix44 operator *(matrix44 &mm);
     
+    //Transform count points held in separate x, y and z arrays, all with the
+    //same w. Outputs go to separate arrays too, ow may be NULL. Runs the same
+    //multiplies and adds in the same order as operator *, so results are
+    //bit-identical as long as neither path gets contracted into FMAs.
+    void transform(const float *x, const float *y, const float *z, float w,
+                   float *ox, float *oy, float *oz, float *ow, int count) const;
+    
     void transpose();
     void inverse();
 };
@@ -32,9 +51,14 @@ inline matrix44::matrix44() {
 }
 
 inline matrix44::matrix44(const matrix44 &mm) {
+#ifdef SIMD_MATH
+    for (int i=0; i<4; i++)
+        _mm_store_ps(m[i], _mm_load_ps(mm.m[i]));
+#else
     for (int i=0; i<4; i++)
         for (int j=0; j<4; j++)
             m[i][j] = mm.m[i][j];
+#endif
 }
 
 inline float &matrix44::operator ()(const int x, const int y) {
@@ -43,15 +67,73 @@ inline float &matrix44::operator ()(const int x, const int y) {
 
 inline vector4 matrix44::operator *(const vector4 &vv) {
     vector4 v;
+#ifdef SIMD_MATH
+    //scale the columns by the components of vv, lane i of column k times vv[k]
+    //is m[i][k]*vv[k], so the sums run in the scalar order. Every call pays for
+    //the transpose, many points are better off going through transform().
+    __m128 c0 = _mm_load_ps(m[0]);
+    __m128 c1 = _mm_load_ps(m[1]);
+    __m128 c2 = _mm_load_ps(m[2]);
+    __m128 c3 = _mm_load_ps(m[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 t0 = _mm_mul_ps(c0, _mm_shuffle_ps(vv.v, vv.v, _MM_SHUFFLE(0, 0, 0, 0)));
+    __m128 t1 = _mm_mul_ps(c1, _mm_shuffle_ps(vv.v, vv.v, _MM_SHUFFLE(1, 1, 1, 1)));
+    __m128 t2 = _mm_mul_ps(c2, _mm_shuffle_ps(vv.v, vv.v, _MM_SHUFFLE(2, 2, 2, 2)));
+    __m128 t3 = _mm_mul_ps(c3, _mm_shuffle_ps(vv.v, vv.v, _MM_SHUFFLE(3, 3, 3, 3)));
+    v.v = _mm_add_ps(_mm_add_ps(_mm_add_ps(t0, t1), t2), t3);
+#else
     v.x = m[0][0]*vv.x + m[0][1]*vv.y + m[0][2]*vv.z + m[0][3]*vv.w;
     v.y = m[1][0]*vv.x + m[1][1]*vv.y + m[1][2]*vv.z + m[1][3]*vv.w;
     v.z = m[2][0]*vv.x + m[2][1]*vv.y + m[2][2]*vv.z + m[2][3]*vv.w;
     v.w = m[3][0]*vv.x + m[3][1]*vv.y + m[3][2]*vv.z + m[3][3]*vv.w;
+#endif
     return v;
 }
 
+inline void matrix44::transform(const float *x, const float *y, const float *z, float w,
+                                float *ox, float *oy, float *oz, float *ow, int count) const {
+    float *out[4] = {ox, oy, oz, ow};
+    int rows = ow ? 4 : 3;
+    int i = 0;
+#ifdef SIMD_WIDTH
+    vfloat c[4][4];
+    for (int r = 0; r < 4; r++)
+        for (int k = 0; k < 4; k++)
+            c[r][k] = simdSet1(m[r][k]);
+    vfloat vw = simdSet1(w);
+    
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        vfloat vx = simdLoadUnaligned(x + i);
+        vfloat vy = simdLoadUnaligned(y + i);
+        vfloat vz = simdLoadUnaligned(z + i);
+        for (int r = 0; r < rows; r++) {
+            vfloat v = simdAdd(simdMul(c[r][0], vx), simdMul(c[r][1], vy));
+            v = simdAdd(v, simdMul(c[r][2], vz));
+            v = simdAdd(v, simdMul(c[r][3], vw));
+            simdStoreUnaligned(out[r] + i, v);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (int r = 0; r < rows; r++) {
+            out[r][i] = m[r][0]*x[i] + m[r][1]*y[i] + m[r][2]*z[i] + m[r][3]*w;
+        }
+    }
+}
+
 inline matrix44 matrix44::operator *(matrix44 &mm) {
     matrix44 r;
+#ifdef SIMD_MATH
+    __m128 b[4];
+    for (int k = 0; k < 4; k++) b[k] = _mm_load_ps(mm.m[k]);
+    for (int i = 0; i < 4; i++) {
+        __m128 v = _mm_setzero_ps();
+        for (int k = 0; k < 4; k++) {
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m[i][k]), b[k]));
+        }
+        _mm_store_ps(r.m[i], v);
+    }
+#else
     for (int j = 0; j < 4; j++) {
         for (int i = 0; i < 4; i++) {
             float v = 0.0f;
@@ -61,6 +143,7 @@ inline matrix44 matrix44::operator *(matrix44 &mm) {
             r(i, j) = v;
         }
     }
+#endif
     return r;
 }
 
@@ -75,15 +158,66 @@ inline matrix44 matrix44::identity() {
 }
 
 inline void matrix44::transpose() {
+#ifdef SIMD_MATH
+    __m128 r0 = _mm_load_ps(m[0]);
+    __m128 r1 = _mm_load_ps(m[1]);
+    __m128 r2 = _mm_load_ps(m[2]);
+    __m128 r3 = _mm_load_ps(m[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_store_ps(m[0], r0);
+    _mm_store_ps(m[1], r1);
+    _mm_store_ps(m[2], r2);
+    _mm_store_ps(m[3], r3);
+#else
     for (int i = 0; i < 4; i++)
         for (int j = i+1; j < 4; j++) {
             float t = m[i][j];
             m[i][j] = m[j][i];
             m[j][i] = t;
         }
+#endif
 }
 
+#ifdef SIMD_MATH
+inline __m128 simdCross3(__m128 a, __m128 b) {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+    return _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+}
+#endif
+
 inline void matrix44::inverse() {
+#ifdef SIMD_MATH
+    //same result as below: the upper 3x3 is inverted and the first three
+    //entries of the bottom row negated, the last column is left alone.
+    //The inverse's columns are the cross products of the rows over the determinant.
+    __m128 r0 = _mm_load_ps(m[0]);
+    __m128 r1 = _mm_load_ps(m[1]);
+    __m128 r2 = _mm_load_ps(m[2]);
+    __m128 r3 = _mm_load_ps(m[3]);
+    __m128 c0 = simdCross3(r1, r2);
+    __m128 c1 = simdCross3(r2, r0);
+    __m128 c2 = simdCross3(r0, r1);
+    __m128 c3 = _mm_setzero_ps();
+    
+    __m128 d = _mm_mul_ps(r0, c0);
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0)),
+                                       _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))),
+                            _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2)));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    c0 = _mm_mul_ps(c0, invDet);
+    c1 = _mm_mul_ps(c1, invDet);
+    c2 = _mm_mul_ps(c2, invDet);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    
+    const __m128 lastColumn = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    _mm_store_ps(m[0], _mm_or_ps(_mm_andnot_ps(lastColumn, c0), _mm_and_ps(lastColumn, r0)));
+    _mm_store_ps(m[1], _mm_or_ps(_mm_andnot_ps(lastColumn, c1), _mm_and_ps(lastColumn, r1)));
+    _mm_store_ps(m[2], _mm_or_ps(_mm_andnot_ps(lastColumn, c2), _mm_and_ps(lastColumn, r2)));
+    _mm_store_ps(m[3], _mm_xor_ps(r3, _mm_setr_ps(-0.0f, -0.0f, -0.0f, 0.0f)));
+#else
     float t[3][6];
     int i, j, k;
     float f;
@@ -118,6 +252,7 @@ inline void matrix44::inverse() {
     m[3][0] = -m[3][0];
     m[3][1] = -m[3][1];
     m[3][2] = -m[3][2];
+#endif
 }
 
 void matrix44::dump() {
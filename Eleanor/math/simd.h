@@ -0,0 +1,94 @@
+//
+//  simd.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef simd_h
+#define simd_h
+
+//Thin wrappers over the widest vector unit the compiler targets.
+//SIMD_WIDTH is 8 with AVX2, 4 with SSE2 and undefined otherwise,
+//in which case callers keep to their scalar loops.
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+
+typedef __m256 vfloat;
+typedef __m256i vint;
+
+inline vfloat simdLoad(const float *p) {return _mm256_load_ps(p);}
+inline void simdStore(float *p, vfloat a) {_mm256_store_ps(p, a);}
+inline vfloat simdLoadUnaligned(const float *p) {return _mm256_loadu_ps(p);}
+inline void simdStoreUnaligned(float *p, vfloat a) {_mm256_storeu_ps(p, a);}
+inline vfloat simdSet1(float a) {return _mm256_set1_ps(a);}
+inline vfloat simdAdd(vfloat a, vfloat b) {return _mm256_add_ps(a, b);}
+inline vfloat simdMul(vfloat a, vfloat b) {return _mm256_mul_ps(a, b);}
+inline vfloat simdDiv(vfloat a, vfloat b) {return _mm256_div_ps(a, b);}
+inline vfloat simdMin(vfloat a, vfloat b) {return _mm256_min_ps(a, b);}
+inline vfloat simdMax(vfloat a, vfloat b) {return _mm256_max_ps(a, b);}
+inline int simdMaskGE(vfloat a, vfloat b) {return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ));}
+
+inline vint simdLoadInt(const int *p) {return _mm256_load_si256((const __m256i *)p);}
+inline void simdStoreInt(int *p, vint a) {_mm256_store_si256((__m256i *)p, a);}
+inline vint simdSet1Int(int a) {return _mm256_set1_epi32(a);}
+inline vint simdAddInt(vint a, vint b) {return _mm256_add_epi32(a, b);}
+inline vint simdOrInt(vint a, vint b) {return _mm256_or_si256(a, b);}
+inline vfloat simdToFloat(vint a) {return _mm256_cvtepi32_ps(a);}
+//round to nearest even, like lrintf
+inline vint simdRoundToInt(vfloat a) {return _mm256_cvtps_epi32(a);}
+inline vint simdCastToInt(vfloat a) {return _mm256_castps_si256(a);}
+inline int simdMaskGTInt(vint a, vint b) {return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)));}
+inline int simdMaskEqInt(vint a, vint b) {return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));}
+//bit i set when lane i is >= 0
+inline int simdMaskNonNegative(vint a) {return ~_mm256_movemask_ps(_mm256_castsi256_ps(a)) & 0xff;}
+
+#define SIMD_ALIGN alignas(32)
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+
+typedef __m128 vfloat;
+typedef __m128i vint;
+
+inline vfloat simdLoad(const float *p) {return _mm_load_ps(p);}
+inline void simdStore(float *p, vfloat a) {_mm_store_ps(p, a);}
+inline vfloat simdLoadUnaligned(const float *p) {return _mm_loadu_ps(p);}
+inline void simdStoreUnaligned(float *p, vfloat a) {_mm_storeu_ps(p, a);}
+inline vfloat simdSet1(float a) {return _mm_set1_ps(a);}
+inline vfloat simdAdd(vfloat a, vfloat b) {return _mm_add_ps(a, b);}
+inline vfloat simdMul(vfloat a, vfloat b) {return _mm_mul_ps(a, b);}
+inline vfloat simdDiv(vfloat a, vfloat b) {return _mm_div_ps(a, b);}
+inline vfloat simdMin(vfloat a, vfloat b) {return _mm_min_ps(a, b);}
+inline vfloat simdMax(vfloat a, vfloat b) {return _mm_max_ps(a, b);}
+inline int simdMaskGE(vfloat a, vfloat b) {return _mm_movemask_ps(_mm_cmpge_ps(a, b));}
+
+inline vint simdLoadInt(const int *p) {return _mm_load_si128((const __m128i *)p);}
+inline void simdStoreInt(int *p, vint a) {_mm_store_si128((__m128i *)p, a);}
+inline vint simdSet1Int(int a) {return _mm_set1_epi32(a);}
+inline vint simdAddInt(vint a, vint b) {return _mm_add_epi32(a, b);}
+inline vint simdOrInt(vint a, vint b) {return _mm_or_si128(a, b);}
+inline vfloat simdToFloat(vint a) {return _mm_cvtepi32_ps(a);}
+inline vint simdRoundToInt(vfloat a) {return _mm_cvtps_epi32(a);}
+inline vint simdCastToInt(vfloat a) {return _mm_castps_si128(a);}
+inline int simdMaskGTInt(vint a, vint b) {return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b)));}
+inline int simdMaskEqInt(vint a, vint b) {return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));}
+inline int simdMaskNonNegative(vint a) {return ~_mm_movemask_ps(_mm_castsi128_ps(a)) & 0xf;}
+
+#define SIMD_ALIGN alignas(16)
+
+#endif
+
+//vector4 and matrix44 keep their components in SSE registers unless
+//NO_SIMD_MATH is defined, both variants have the same interface
+#if defined(__SSE2__) && !defined(NO_SIMD_MATH)
+#define SIMD_MATH
+#endif
+
+#endif /* simd_h */
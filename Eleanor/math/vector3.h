@@ -9,6 +9,8 @@
 #ifndef vector3_h
 #define vector3_h
 
+#include <cmath>
+
 struct vector3 {
     union {
         struct {float x, y, z;};
@@ -66,15 +68,11 @@ inline vector3 vector3::operator -(const vector3 &vv) const {
 }
 
 inline float &vector3::operator [](const int index) {
-    if (index == 0) return x;
-    else if (index == 1) return y;
-    else return z;
+    return (&x)[index];
 }
 
 inline const float &vector3::operator [](const int index) const {
-    if (index == 0) return x;
-    else if (index == 1) return y;
-    else return z;
+    return (&x)[index];
 }
 
 inline const vector3 &vector3::operator=(const vector3 &vv) {
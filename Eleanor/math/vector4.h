@@ -9,10 +9,17 @@
 #ifndef vector4_h
 #define vector4_h
 
+#include <cmath>
+
+#include "simd.h"
+
 struct vector4 {
     union {
         struct {float x,y,z,w;};
         struct {float r,g,b,a;};
+#ifdef SIMD_MATH
+        __m128 v;
+#endif
     };
     
     vector4();
@@ -26,10 +33,14 @@ struct vector4 {
     float &operator [](const int index);
     const vector4 &operator =(const vector4 &vv);
     vector4 &operator /(const float d) {
+#ifdef SIMD_MATH
+        v = _mm_div_ps(v, _mm_set1_ps(d));
+#else
         x /= d;
         y /= d;
         z /= d;
         w /= d;
+#endif
         return *this;
     }
     
@@ -39,9 +50,15 @@ struct vector4 {
 };
 
 inline vector4::vector4() {}
+#ifdef SIMD_MATH
+inline vector4::vector4(const vector4 &vv) : v(vv.v) {}
+inline vector4::vector4(const float xx, const float yy, const float zz, const float ww) : v(_mm_setr_ps(xx, yy, zz, ww)) {}
+inline vector4::vector4(const vector3 &vv, const float ww) : v(_mm_setr_ps(vv.x, vv.y, vv.z, ww)) {}
+#else
 inline vector4::vector4(const vector4 &vv) : x(vv.x), y(vv.y), z(vv.z), w(vv.w) {}
 inline vector4::vector4(const float xx, const float yy, const float zz, const float ww) : x(xx), y(yy), z(zz), w(ww) {}
 inline vector4::vector4(const vector3 &vv, const float ww) : x(vv.x), y(vv.y), z(vv.z), w(ww) {}
+#endif
 
 inline float vector4::length() const {
     return sqrt(x*x+y*y+z*z+w*w);
@@ -50,25 +67,30 @@ inline float vector4::length() const {
 inline vector4 &vector4::normalize() {
     const float len = length();
     const float invLen = 1.0f/len;
+#ifdef SIMD_MATH
+    v = _mm_mul_ps(v, _mm_set1_ps(invLen));
+#else
     x *= invLen;
     y *= invLen;
     z *= invLen;
     w *= invLen;
+#endif
     return *this;
 }
 
 inline float &vector4::operator [](const int index) {
-    if (index == 0) return x;
-    else if (index == 1) return y;
-    else if (index == 2) return z;
-    else return w;
+    return (&x)[index];
 }
 
 inline const vector4 &vector4::operator =(const vector4 &vv) {
+#ifdef SIMD_MATH
+    v = vv.v;
+#else
     x = vv.x;
     y = vv.y;
     z = vv.z;
     w = vv.w;
+#endif
     return *this;
 }
 
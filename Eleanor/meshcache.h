@@ -0,0 +1,212 @@
+//
+//  meshcache.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef meshcache_h
+#define meshcache_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include "mappedfile.h"
+
+//Binary image of a Model's geometry, written after an OBJ has been parsed and
+//mapped back on the next load instead of parsing it again. The file is a
+//header followed by sections of raw arrays in native byte order, each 16-byte
+//aligned, so Model reads them in place from the mapping.
+//The header records the size and modification time of the OBJ it was built
+//from, and of the other files it depends on, the OBJ's MTL files; a cache
+//that no longer matches them is ignored and rewritten.
+class MeshCache {
+public:
+    enum Section {
+        MESH_VERTICES,          //8 floats per vertex, in the layout the flags name
+        MESH_INDICES,           //uint32 vertex per face corner
+        MESH_VERTEX_CORNERS,    //int first face corner per vertex
+        MESH_TANGENTS,          //float x,y,z per face
+        MESH_MATERIAL_IDS,      //int per face, -1 without material
+        MESH_MATERIALS,         //NUL terminated strings, MATERIAL_STRINGS per material
+        SECTION_COUNT
+    };
+
+    static const int VERSION = 4;
+    static const int MATERIAL_STRINGS = 4;
+
+    MeshCache() {}
+    ~MeshCache() {close();}
+
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+
+    //maps filename if it is a cache of source as source is now, written
+    //with the same flags, the options the geometry was built with
+    bool open(const std::string &filename, const std::string &source, uint32_t flags);
+    void close();
+
+    bool isOpen() const {return file.isOpen();}
+
+    //start of a section and its number of elements of type T
+    template <class T>
+    const T *get(Section s, size_t &count) const {
+        count = header().sections[s].bytes / sizeof(T);
+        return reinterpret_cast<const T *>(file.data() + header().sections[s].offset);
+    }
+
+    //writes the sections of source's geometry, through a temporary file so a
+    //reader never maps a partly written cache. dependencies are the other
+    //files it was built from, they need not exist.
+    static bool write(const std::string &filename, const std::string &source, const std::vector<std::string> &dependencies, uint32_t flags, const void *const sections[SECTION_COUNT], const size_t bytes[SECTION_COUNT]);
+
+private:
+    struct SectionEntry {
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint32_t flags;
+        uint32_t reserved;
+        int64_t sourceSize;
+        int64_t sourceTime;             //ns
+        SectionEntry dependencies;      //a Dependency and its NUL terminated path, 8-byte aligned, per file
+        SectionEntry sections[SECTION_COUNT];
+    };
+
+    struct Dependency {
+        int64_t size;       //-1 when the file did not exist
+        int64_t time;
+    };
+
+    MappedFile file;
+
+    const Header &header() const {return *reinterpret_cast<const Header *>(file.data());}
+
+    //size and modification time in ns, a file rewritten within the same
+    //second usually still gets a new time
+    static bool stamp(const std::string &source, int64_t &size, int64_t &time);
+    bool dependenciesValid() const;
+};
+
+bool MeshCache::stamp(const std::string &source, int64_t &size, int64_t &time) {
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0) return false;
+    size = (int64_t)st.st_size;
+#ifdef __APPLE__
+    time = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    time = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool MeshCache::dependenciesValid() const {
+    const char *p = file.data() + header().dependencies.offset;
+    const char *end = p + header().dependencies.bytes;
+    while (p < end) {
+        Dependency d, now = {-1, 0};
+        if ((size_t)(end - p) < sizeof(d)) return false;
+        memcpy(&d, p, sizeof(d));
+        const char *path = p + sizeof(d);
+        const char *nul = (const char *)memchr(path, 0, end - path);
+        if (!nul) return false;
+        stamp(path, now.size, now.time);
+        if (now.size != d.size || now.time != d.time) return false;
+        p += (sizeof(d) + (nul + 1 - path) + 7) & ~(size_t)7;
+    }
+    return true;
+}
+
+bool MeshCache::open(const std::string &filename, const std::string &source, uint32_t flags) {
+    close();
+
+    int64_t sourceSize, sourceTime;
+    if (!stamp(source, sourceSize, sourceTime)) return false;
+
+    if (!file.open(filename)) return false;
+    if (file.size() < sizeof(Header)) {
+        close();
+        return false;
+    }
+
+    size_t size = file.size();
+    const Header &h = header();
+    bool valid = memcmp(h.magic, "ELEMESH", 8) == 0 && h.version == VERSION && h.sectionCount == SECTION_COUNT
+                 && h.flags == flags && h.sourceSize == sourceSize && h.sourceTime == sourceTime;
+    for (int s = 0; valid && s < SECTION_COUNT; s++) {
+        valid = h.sections[s].offset % 16 == 0 && h.sections[s].offset <= size && h.sections[s].bytes <= size - h.sections[s].offset;
+    }
+    valid = valid && h.dependencies.offset <= size && h.dependencies.bytes <= size - h.dependencies.offset && dependenciesValid();
+    if (!valid) close();
+    return valid;
+}
+
+void MeshCache::close() {
+    file.close();
+}
+
+bool MeshCache::write(const std::string &filename, const std::string &source, const std::vector<std::string> &dependencies, uint32_t flags, const void *const sections[SECTION_COUNT], const size_t bytes[SECTION_COUNT]) {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "ELEMESH", 8);
+    h.version = VERSION;
+    h.sectionCount = SECTION_COUNT;
+    h.flags = flags;
+    if (!stamp(source, h.sourceSize, h.sourceTime)) return false;
+
+    std::string stamps;
+    for (size_t i = 0; i < dependencies.size(); i++) {
+        Dependency d = {-1, 0};
+        stamp(dependencies[i], d.size, d.time);
+        stamps.append((const char *)&d, sizeof(d));
+        stamps.append(dependencies[i].c_str(), dependencies[i].size() + 1);
+        stamps.resize((stamps.size() + 7) & ~(size_t)7, '\0');
+    }
+
+    uint64_t offset = (sizeof(Header) + 15) & ~(uint64_t)15;
+    h.dependencies.offset = offset;
+    h.dependencies.bytes = stamps.size();
+    offset = (offset + stamps.size() + 15) & ~(uint64_t)15;
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        h.sections[s].offset = offset;
+        h.sections[s].bytes = bytes[s];
+        offset = (offset + bytes[s] + 15) & ~(uint64_t)15;
+    }
+
+    std::string tmpfile = filename + ".tmp";
+    FILE *f = fopen(tmpfile.c_str(), "wb");
+    if (!f) return false;
+
+    static const char zeros[16] = {0};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    uint64_t written = sizeof(h);
+    ok = ok && fwrite(zeros, 1, h.dependencies.offset - written, f) == h.dependencies.offset - written;
+    if (ok && !stamps.empty()) ok = fwrite(stamps.data(), 1, stamps.size(), f) == stamps.size();
+    written = h.dependencies.offset + stamps.size();
+    for (int s = 0; ok && s < SECTION_COUNT; s++) {
+        ok = fwrite(zeros, 1, h.sections[s].offset - written, f) == h.sections[s].offset - written;
+        if (ok && bytes[s]) ok = fwrite(sections[s], 1, bytes[s], f) == bytes[s];
+        written = h.sections[s].offset + bytes[s];
+    }
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmpfile.c_str(), filename.c_str()) != 0) {
+        remove(tmpfile.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif /* meshcache_h */
@@ -0,0 +1,266 @@
+//
+//  meshoptimizer.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef meshoptimizer_h
+#define meshoptimizer_h
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "math/math.h"
+
+//Load-time reordering of an indexed triangle list, in three passes:
+//vertexCache() orders the faces so consecutive faces reuse recently
+//transformed vertices, overdraw() then regroups that order into clusters
+//drawn outside-first so early depth rejects more of what is behind them, and
+//vertexFetch() renumbers the vertices in the order the faces first use them.
+//The face passes only rewrite the index buffer.
+class MeshOptimizer {
+public:
+    //size of the LRU cache the face order is scored against
+    static const int CACHE_SIZE = 32;
+
+    //average cache miss ratio, transformed vertices per face, of a FIFO
+    //post-transform cache of cacheSize vertices; 3 is no reuse at all
+    static float acmr(const std::vector<uint32_t> &indices, int vertexCount, int cacheSize = 16);
+
+    //Tom Forsyth's linear-speed vertex cache optimisation
+    static void vertexCache(std::vector<uint32_t> &indices, int vertexCount);
+
+    //Sander et al.'s cluster sort. The cache-ordered faces are cut where the
+    //ACMR of the cluster so far drops to threshold times the whole mesh's,
+    //restarting the cache, so reordering the clusters costs at most that
+    //much cache efficiency. Returns the number of clusters.
+    static int overdraw(std::vector<uint32_t> &indices, const float *positions, int positionStride, float threshold = 1.05f);
+
+    //remap[old vertex] = new vertex, in order of first use
+    static void vertexFetch(std::vector<uint32_t> &indices, int vertexCount, std::vector<int> &remap);
+
+private:
+    //Forsyth's score of a vertex by its LRU position, -1 when outside the
+    //cache, and the number of faces still to emit that use it
+    static float vertexScore(int cachePosition, int remaining);
+
+    //moves faces to the order of order[i], the face to place i-th
+    static void permute(std::vector<uint32_t> &indices, const std::vector<int> &order);
+};
+
+float MeshOptimizer::acmr(const std::vector<uint32_t> &indices, int vertexCount, int cacheSize) {
+    if (indices.size() < 3) return 0.0f;
+    std::vector<unsigned> stamp(vertexCount, 0);
+    unsigned time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t v = indices[i];
+        //a FIFO entry stays for the next cacheSize misses
+        if (time - stamp[v] > (unsigned)cacheSize) {
+            stamp[v] = time++;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+float MeshOptimizer::vertexScore(int cachePosition, int remaining) {
+    if (remaining == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        //the last face's vertices score the same whatever their order
+        if (cachePosition < 3) score = 0.75f;
+        else score = powf(1.0f - (float)(cachePosition - 3) / (CACHE_SIZE - 3), 1.5f);
+    }
+    //favour vertices with few faces left, so they are not stranded
+    return score + 2.0f / sqrtf((float)remaining);
+}
+
+void MeshOptimizer::permute(std::vector<uint32_t> &indices, const std::vector<int> &order) {
+    std::vector<uint32_t> sorted(indices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        for (int k = 0; k < 3; k++) sorted[3*i + k] = indices[3*order[i] + k];
+    }
+    indices.swap(sorted);
+}
+
+void MeshOptimizer::vertexCache(std::vector<uint32_t> &indices, int vertexCount) {
+    int faceCount = (int)(indices.size() / 3);
+    if (faceCount == 0) return;
+
+    //faces of each vertex, the first remaining[v] of them still to emit
+    std::vector<int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) remaining[indices[i]]++;
+    std::vector<int> offsets(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (int)(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (int v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> faceScore(faceCount);
+    for (int f = 0; f < faceCount; f++) {
+        faceScore[f] = score[indices[3*f]] + score[indices[3*f + 1]] + score[indices[3*f + 2]];
+    }
+
+    std::vector<char> emitted(faceCount, 0);
+    std::vector<int> order;
+    order.reserve(faceCount);
+    //the face's vertices can push up to 3 out of a full cache
+    int cache[CACHE_SIZE + 3], newCache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    int cursor = 0;
+    int best = (int)(std::max_element(faceScore.begin(), faceScore.end()) - faceScore.begin());
+
+    while (best >= 0) {
+        order.push_back(best);
+        emitted[best] = 1;
+
+        int newCount = 0;
+        for (int k = 0; k < 3; k++) {
+            int v = (int)indices[3*best + k];
+            //a degenerate face lists a vertex twice, it enters the cache once
+            if (std::find(newCache, newCache + newCount, v) != newCache + newCount) continue;
+            newCache[newCount++] = v;
+            for (int a = offsets[v]; a < offsets[v] + remaining[v];) {
+                if (adjacency[a] == best) adjacency[a] = adjacency[offsets[v] + --remaining[v]];
+                else a++;
+            }
+        }
+        int faceVertices = newCount;
+        for (int i = 0; i < cacheCount; i++) {
+            if (std::find(newCache, newCache + faceVertices, cache[i]) == newCache + faceVertices) newCache[newCount++] = cache[i];
+        }
+        for (int i = CACHE_SIZE; i < newCount; i++) cachePosition[newCache[i]] = -1;
+        cacheCount = std::min(newCount, (int)CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        //rescore everything that moved, and pick the best face among those
+        //of the vertices still cached
+        for (int i = 0; i < newCount; i++) {
+            int v = newCache[i];
+            if (i < CACHE_SIZE) cachePosition[v] = i;
+            float s = vertexScore(cachePosition[v], remaining[v]);
+            float delta = s - score[v];
+            score[v] = s;
+            for (int a = offsets[v]; a < offsets[v] + remaining[v]; a++) faceScore[adjacency[a]] += delta;
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            for (int a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                if (faceScore[adjacency[a]] > bestScore) {
+                    bestScore = faceScore[adjacency[a]];
+                    best = adjacency[a];
+                }
+            }
+        }
+
+        //nothing left around the cache, continue with the next face in the
+        //original order
+        if (best < 0) {
+            while (cursor < faceCount && emitted[cursor]) cursor++;
+            if (cursor < faceCount) best = cursor;
+        }
+    }
+
+    permute(indices, order);
+}
+
+int MeshOptimizer::overdraw(std::vector<uint32_t> &indices, const float *positions, int positionStride, float threshold) {
+    const int FIFO_SIZE = 16;
+    int faceCount = (int)(indices.size() / 3);
+    if (faceCount == 0) return 0;
+    int vertexCount = 0;
+    for (size_t i = 0; i < indices.size(); i++) vertexCount = std::max(vertexCount, (int)indices[i] + 1);
+
+    //cut into clusters, each with a cache of its own
+    float limit = acmr(indices, vertexCount, FIFO_SIZE) * threshold;
+    std::vector<int> clusters;
+    std::vector<unsigned> stamp(vertexCount, 0);
+    unsigned time = FIFO_SIZE + 1;
+    int misses = 0, start = 0;
+    for (int f = 0; f < faceCount; f++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[3*f + k];
+            if (time - stamp[v] > (unsigned)FIFO_SIZE) {
+                stamp[v] = time++;
+                misses++;
+            }
+        }
+        if ((float)misses <= limit * (f + 1 - start)) {
+            clusters.push_back(start);
+            start = f + 1;
+            misses = 0;
+            time += FIFO_SIZE + 1;
+        }
+    }
+    if (start < faceCount) clusters.push_back(start);
+    int clusterCount = (int)clusters.size();
+    clusters.push_back(faceCount);
+
+    //area weighted centroid and normal of each cluster and of the mesh
+    std::vector<vector3> centroid(clusterCount), normal(clusterCount);
+    vector3 meshCentroid(0, 0, 0);
+    float meshArea = 0.0f;
+    std::vector<float> area(clusterCount, 0.0f);
+    for (int c = 0; c < clusterCount; c++) {
+        vector3 sum(0, 0, 0), n(0, 0, 0);
+        for (int f = clusters[c]; f < clusters[c + 1]; f++) {
+            const float *p0 = positions + indices[3*f] * positionStride;
+            const float *p1 = positions + indices[3*f + 1] * positionStride;
+            const float *p2 = positions + indices[3*f + 2] * positionStride;
+            vector3 e1(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+            vector3 e2(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+            vector3 cross(e1.y*e2.z - e1.z*e2.y, e1.z*e2.x - e1.x*e2.z, e1.x*e2.y - e1.y*e2.x);
+            float a = cross.length();
+            n = n + cross;
+            sum = sum + vector3(p0[0] + p1[0] + p2[0], p0[1] + p1[1] + p2[1], p0[2] + p1[2] + p2[2]) * (a / 3.0f);
+            area[c] += a;
+        }
+        meshCentroid = meshCentroid + sum;
+        meshArea += area[c];
+        centroid[c] = area[c] > 0.0f ? sum / area[c] : sum;
+        normal[c] = n.length() > 0.0f ? n.normalize() : n;
+    }
+    if (meshArea > 0.0f) meshCentroid = meshCentroid / meshArea;
+
+    //clusters far out along their normal face the outside of the mesh and
+    //are drawn first, they tend to hide the rest
+    std::vector<float> key(clusterCount);
+    for (int c = 0; c < clusterCount; c++) key[c] = (centroid[c] - meshCentroid) * normal[c];
+    std::vector<int> sorted(clusterCount);
+    for (int c = 0; c < clusterCount; c++) sorted[c] = c;
+    std::stable_sort(sorted.begin(), sorted.end(), [&key](int a, int b) {return key[a] > key[b];});
+
+    std::vector<int> order;
+    order.reserve(faceCount);
+    for (int i = 0; i < clusterCount; i++) {
+        for (int f = clusters[sorted[i]]; f < clusters[sorted[i] + 1]; f++) order.push_back(f);
+    }
+    permute(indices, order);
+    return clusterCount;
+}
+
+void MeshOptimizer::vertexFetch(std::vector<uint32_t> &indices, int vertexCount, std::vector<int> &remap) {
+    remap.assign(vertexCount, -1);
+    int next = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        int &v = remap[indices[i]];
+        if (v < 0) v = next++;
+        indices[i] = (uint32_t)v;
+    }
+    //vertices no face uses go last
+    for (int v = 0; v < vertexCount; v++) {
+        if (remap[v] < 0) remap[v] = next++;
+    }
+}
+
+#endif /* meshoptimizer_h */
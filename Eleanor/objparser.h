@@ -0,0 +1,384 @@
+//
+//  objparser.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef objparser_h
+#define objparser_h
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <fstream>
+
+#include "mappedfile.h"
+#include "threadpool.h"
+
+//tinyobj's MTL file reader, keeping the path of every file it was asked for,
+//found or not
+class RecordingMaterialReader : public tinyobj::MaterialFileReader {
+public:
+    RecordingMaterialReader(const std::string &basedir, std::vector<std::string> &files)
+        : tinyobj::MaterialFileReader(basedir), basedir(basedir), files(files) {}
+
+    virtual bool operator()(const std::string &matId, std::vector<tinyobj::material_t> *materials, std::map<std::string, int> *matMap, std::string *err) {
+        files.push_back(basedir + matId);
+        return tinyobj::MaterialFileReader::operator()(matId, materials, matMap, err);
+    }
+
+private:
+    std::string basedir;
+    std::vector<std::string> &files;
+};
+
+//Parallel front end of tinyobj::LoadObj, with the same output. The file is
+//mapped and split into line-aligned chunks, whose v/vn/vt/f records are
+//parsed concurrently with tinyobj's own number parser. The chunks are then
+//stitched together with prefix sums of their counts, which also resolve
+//relative indices, and the few records that shape the result (g, o, usemtl,
+//mtllib) are replayed in order on the merged triangles.
+//Files with records it does not reproduce, tags for now, go through
+//tinyobj::LoadObj.
+class ObjParser {
+public:
+    //the chunks are parsed on the caller's pool, which must not run another
+    //parallelFor during load()
+    ObjParser(ThreadPool &pool) : pool(pool) {}
+
+    //same arguments and results as tinyobj::LoadObj with triangulation
+    bool load(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *filename, const char *mtl_basedir = NULL);
+
+    //the MTL files the last load() read or looked for
+    const std::vector<std::string> &getMaterialFiles() const {return materialFiles;}
+
+private:
+    //a g, o, usemtl or mtllib line, and where it came among the faces
+    struct Event {
+        std::string line;
+        size_t polygons;
+        size_t triangles;
+    };
+
+    struct Chunk {
+        const char *begin, *end;
+        std::vector<tinyobj::real_t> v, vn, vt;
+        std::vector<tinyobj::index_t> indices;  //triangulated corners
+        //components of indices given relative to the chunk's counts,
+        //3*corner + 0 position, 1 normal, 2 texcoord
+        std::vector<size_t> relative;
+        size_t polygons = 0;
+        std::vector<Event> events;
+        bool unsupported = false;
+    };
+
+    ThreadPool &pool;
+    std::vector<std::string> materialFiles;
+
+    //tinyobj::LoadObj of a file, through a RecordingMaterialReader
+    bool loadSerial(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *filename, const char *mtl_basedir);
+
+    //tinyobj's parseReal and atoi, scanning the token once
+    static tinyobj::real_t parseReal(const char **token);
+    static int parseInt(const char *p);
+
+    void parseChunk(Chunk &chunk);
+    void parseFace(const char *token, Chunk &chunk, std::vector<tinyobj::index_t> &polygon);
+    void assemble(const std::vector<Chunk> &chunks, const std::vector<tinyobj::index_t> &indices, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *mtl_basedir);
+};
+
+bool ObjParser::load(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *filename, const char *mtl_basedir) {
+    materialFiles.clear();
+    MappedFile file;
+    if (!file.open(filename)) return loadSerial(attrib, shapes, materials, err, filename, mtl_basedir);
+
+    //chunks of at least 256KB, a few per thread to balance their costs
+    const size_t MIN_CHUNK = 256 * 1024;
+    size_t count = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, file.size() / MIN_CHUNK));
+    std::vector<Chunk> chunks(count);
+    const char *data = file.data();
+    const char *end = data + file.size();
+    const char *p = data;
+    for (size_t i = 0; i < count; i++) {
+        chunks[i].begin = p;
+        if (i + 1 == count) {
+            p = end;
+        } else {
+            p = std::max(p, data + file.size() / count * (i + 1));
+            while (p < end && *p != '\n' && *p != '\r') p++;
+            if (p < end) p++;
+        }
+        chunks[i].end = p;
+    }
+
+    pool.parallelFor((int)count, [&](int i, int) {
+        parseChunk(chunks[i]);
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        if (chunks[i].unsupported) {
+            file.close();
+            return loadSerial(attrib, shapes, materials, err, filename, mtl_basedir);
+        }
+    }
+
+    //offsets of every chunk's records in the merged arrays
+    std::vector<size_t> v(count + 1, 0), vn(count + 1, 0), vt(count + 1, 0), indices(count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        v[i + 1] = v[i] + chunks[i].v.size();
+        vn[i + 1] = vn[i] + chunks[i].vn.size();
+        vt[i + 1] = vt[i] + chunks[i].vt.size();
+        indices[i + 1] = indices[i] + chunks[i].indices.size();
+    }
+
+    attrib->vertices.resize(v[count]);
+    attrib->normals.resize(vn[count]);
+    attrib->texcoords.resize(vt[count]);
+    std::vector<tinyobj::index_t> merged(indices[count]);
+
+    pool.parallelFor((int)count, [&](int i, int) {
+        const Chunk &c = chunks[i];
+        std::copy(c.v.begin(), c.v.end(), attrib->vertices.begin() + v[i]);
+        std::copy(c.vn.begin(), c.vn.end(), attrib->normals.begin() + vn[i]);
+        std::copy(c.vt.begin(), c.vt.end(), attrib->texcoords.begin() + vt[i]);
+        tinyobj::index_t *out = merged.data() + indices[i];
+        std::copy(c.indices.begin(), c.indices.end(), out);
+        const int offsets[3] = {(int)(v[i] / 3), (int)(vn[i] / 3), (int)(vt[i] / 2)};
+        for (size_t k = 0; k < c.relative.size(); k++) {
+            tinyobj::index_t &idx = out[c.relative[k] / 3];
+            int component = (int)(c.relative[k] % 3);
+            if (component == 0) idx.vertex_index += offsets[0];
+            else if (component == 1) idx.normal_index += offsets[1];
+            else idx.texcoord_index += offsets[2];
+        }
+    });
+
+    shapes->clear();
+    assemble(chunks, merged, shapes, materials, err, mtl_basedir);
+    return true;
+}
+
+void ObjParser::parseChunk(Chunk &chunk) {
+    std::string line;
+    std::vector<tinyobj::index_t> polygon;
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        //lines end at \n, \r or both, the copy gives the parsers the NUL
+        //terminated string they expect
+        const char *e = p;
+        while (e < chunk.end && *e != '\n' && *e != '\r') e++;
+        line.assign(p, e);
+        p = e + 1;
+
+        const char *token = line.c_str();
+        token += strspn(token, " \t");
+        if (token[0] == '\0' || token[0] == '#') continue;
+
+        if (token[0] == 'v' && IS_SPACE(token[1])) {
+            token += 2;
+            chunk.v.push_back(parseReal(&token));
+            chunk.v.push_back(parseReal(&token));
+            chunk.v.push_back(parseReal(&token));
+        } else if (token[0] == 'v' && token[1] == 'n' && IS_SPACE(token[2])) {
+            token += 3;
+            chunk.vn.push_back(parseReal(&token));
+            chunk.vn.push_back(parseReal(&token));
+            chunk.vn.push_back(parseReal(&token));
+        } else if (token[0] == 'v' && token[1] == 't' && IS_SPACE(token[2])) {
+            token += 3;
+            chunk.vt.push_back(parseReal(&token));
+            chunk.vt.push_back(parseReal(&token));
+        } else if (token[0] == 'f' && IS_SPACE(token[1])) {
+            parseFace(token + 2, chunk, polygon);
+        } else if ((strncmp(token, "usemtl", 6) == 0 && IS_SPACE(token[6])) ||
+                   (strncmp(token, "mtllib", 6) == 0 && IS_SPACE(token[6])) ||
+                   ((token[0] == 'g' || token[0] == 'o') && IS_SPACE(token[1]))) {
+            Event event;
+            event.line = token;
+            event.polygons = chunk.polygons;
+            event.triangles = chunk.indices.size() / 3;
+            chunk.events.push_back(event);
+        } else if (token[0] == 't' && IS_SPACE(token[1])) {
+            chunk.unsupported = true;
+            return;
+        }
+    }
+}
+
+tinyobj::real_t ObjParser::parseReal(const char **token) {
+    const char *p = *token;
+    while (*p == ' ' || *p == '\t') p++;
+    const char *end = p;
+    while (*end && *end != ' ' && *end != '\t' && *end != '\r') end++;
+    //the same digit loop as tinyobj, any other parser rounds differently
+    double val = 0.0;
+    tinyobj::tryParseDouble(p, end, &val);
+    *token = end;
+    return static_cast<tinyobj::real_t>(val);
+}
+
+int ObjParser::parseInt(const char *p) {
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r')) p++;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    int i = 0;
+    while (IS_DIGIT(*p)) i = i*10 + (*p++ - '0');
+    return negative ? -i : i;
+}
+
+//tinyobj's parseTriple, with negative indices left relative to the chunk
+void ObjParser::parseFace(const char *token, Chunk &chunk, std::vector<tinyobj::index_t> &polygon) {
+    const int counts[3] = {(int)(chunk.v.size() / 3), (int)(chunk.vn.size() / 3), (int)(chunk.vt.size() / 2)};
+    std::vector<std::pair<size_t, int> > relative;
+
+    polygon.clear();
+    token += strspn(token, " \t");
+    while (!IS_NEW_LINE(token[0])) {
+        tinyobj::index_t idx;
+        idx.vertex_index = idx.normal_index = idx.texcoord_index = -1;
+        int *components[3] = {&idx.vertex_index, &idx.normal_index, &idx.texcoord_index};
+
+        //position, then texcoord, then normal as in i/j/k, i//k or i/j
+        int order[3] = {0, 2, 1};
+        for (int n = 0; n < 3; n++) {
+            if (n > 0) {
+                if (token[0] != '/') break;
+                token++;
+                if (n == 1 && token[0] == '/') {
+                    token++;
+                    n++;
+                }
+            }
+            int c = order[n];
+            int i = parseInt(token);
+            if (i > 0) *components[c] = i - 1;
+            else if (i == 0) *components[c] = 0;
+            else {
+                *components[c] = counts[c] + i;
+                relative.push_back(std::make_pair(polygon.size(), c));
+            }
+            while (token[0] && token[0] != '/' && token[0] != ' ' && token[0] != '\t' && token[0] != '\r') token++;
+        }
+        polygon.push_back(idx);
+        token += strspn(token, " \t\r");
+    }
+
+    //triangle fan, with the relative components of every copy of a corner
+    chunk.polygons++;
+    for (size_t k = 2; k < polygon.size(); k++) {
+        const size_t corners[3] = {0, k - 1, k};
+        for (int j = 0; j < 3; j++) {
+            for (size_t r = 0; r < relative.size(); r++) {
+                if (relative[r].first == corners[j]) chunk.relative.push_back(3*chunk.indices.size() + relative[r].second);
+            }
+            chunk.indices.push_back(polygon[corners[j]]);
+        }
+    }
+}
+
+bool ObjParser::loadSerial(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *filename, const char *mtl_basedir) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    shapes->clear();
+
+    std::ifstream ifs(filename);
+    if (!ifs) {
+        if (err) *err = std::string("Cannot open file [") + filename + "]\n";
+        return false;
+    }
+    RecordingMaterialReader readMat(mtl_basedir ? mtl_basedir : "", materialFiles);
+    return tinyobj::LoadObj(attrib, shapes, materials, err, &ifs, &readMat, true);
+}
+
+//tinyobj's state machine for the records that group faces into shapes
+void ObjParser::assemble(const std::vector<Chunk> &chunks, const std::vector<tinyobj::index_t> &indices, std::vector<tinyobj::shape_t> *shapes, std::vector<tinyobj::material_t> *materials, std::string *err, const char *mtl_basedir) {
+    RecordingMaterialReader readMat(mtl_basedir ? mtl_basedir : "", materialFiles);
+    std::map<std::string, int> materialMap;
+    int material = -1;
+    std::string name;
+    tinyobj::shape_t shape;
+
+    //the face group runs from these to the current face
+    size_t groupPolygons = 0, groupTriangles = 0;
+
+    auto exportGroup = [&](size_t polygons, size_t triangles) {
+        if (polygons == groupPolygons) return false;
+        shape.mesh.indices.insert(shape.mesh.indices.end(), indices.begin() + 3*groupTriangles, indices.begin() + 3*triangles);
+        shape.mesh.num_face_vertices.insert(shape.mesh.num_face_vertices.end(), triangles - groupTriangles, 3);
+        shape.mesh.material_ids.insert(shape.mesh.material_ids.end(), triangles - groupTriangles, material);
+        shape.name = name;
+        return true;
+    };
+
+    size_t basePolygons = 0, baseTriangles = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        for (size_t e = 0; e < chunks[i].events.size(); e++) {
+            const Event &event = chunks[i].events[e];
+            size_t polygons = basePolygons + event.polygons;
+            size_t triangles = baseTriangles + event.triangles;
+            const char *token = event.line.c_str();
+
+            if (token[0] == 'u') {
+                char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+                namebuf[0] = '\0';
+                std::sscanf(token + 7, "%s", namebuf);
+                int newMaterial = materialMap.count(namebuf) ? materialMap[namebuf] : -1;
+                if (newMaterial != material) {
+                    exportGroup(polygons, triangles);
+                    groupPolygons = polygons;
+                    groupTriangles = triangles;
+                    material = newMaterial;
+                }
+            } else if (token[0] == 'm') {
+                std::vector<std::string> filenames;
+                tinyobj::SplitString(std::string(token + 7), ' ', filenames);
+                if (filenames.empty()) {
+                    if (err) (*err) += "WARN: Looks like empty filename for mtllib. Use default material. \n";
+                } else {
+                    bool found = false;
+                    for (size_t s = 0; s < filenames.size() && !found; s++) {
+                        std::string errMtl;
+                        found = readMat(filenames[s].c_str(), materials, &materialMap, &errMtl);
+                        if (err) (*err) += errMtl;
+                    }
+                    if (!found && err) (*err) += "WARN: Failed to load material file(s). Use default material.\n";
+                }
+            } else {
+                if (exportGroup(polygons, triangles)) shapes->push_back(shape);
+                shape = tinyobj::shape_t();
+                groupPolygons = polygons;
+                groupTriangles = triangles;
+
+                if (token[0] == 'g') {
+                    std::vector<std::string> names;
+                    while (!IS_NEW_LINE(token[0])) {
+                        names.push_back(tinyobj::parseString(&token));
+                        token += strspn(token, " \t\r");
+                    }
+                    name = names.size() > 1 ? names[1] : "";
+                } else {
+                    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+                    namebuf[0] = '\0';
+                    std::sscanf(token + 2, "%s", namebuf);
+                    name = namebuf;
+                }
+            }
+        }
+        basePolygons += chunks[i].polygons;
+        baseTriangles += chunks[i].indices.size() / 3;
+    }
+
+    if (exportGroup(basePolygons, baseTriangles) || shape.mesh.indices.size()) shapes->push_back(shape);
+}
+
+#endif /* objparser_h */
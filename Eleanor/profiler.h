@@ -0,0 +1,141 @@
+//
+//  profiler.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef profiler_h
+#define profiler_h
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+
+//Build with ELEANOR_PROFILE to time the pipeline stages and count pixels.
+//Without it every PROFILE_ macro expands to nothing and the renderer is
+//compiled exactly as before.
+#ifdef ELEANOR_PROFILE
+
+inline long long profileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceEvent {
+    const char *name;   //a string literal, events only keep the pointer
+    long long start;    //ns
+    long long duration;
+};
+
+//Fixed-size buffer of the latest events of one thread, the oldest ones are
+//overwritten once it is full. Only its own thread writes to it, so it needs
+//no locking as long as it is read between frames.
+class TraceRing {
+public:
+    TraceRing(size_t capacity = 1 << 14) : events(capacity) {}
+
+    void push(const char *name, long long start, long long duration) {
+        TraceEvent &e = events[written % events.size()];
+        e.name = name;
+        e.start = start;
+        e.duration = duration;
+        written++;
+    }
+
+    size_t size() const {return std::min(written, events.size());}
+
+    //i-th oldest event still held
+    const TraceEvent &operator[](size_t i) const {
+        return events[(written - size() + i) % events.size()];
+    }
+
+    void clear() {written = 0;}
+
+private:
+    std::vector<TraceEvent> events;
+    size_t written = 0;
+};
+
+//records the lifetime of a scope as a trace event
+class TraceScope {
+public:
+    TraceScope(TraceRing &r, const char *n) : ring(r), name(n), start(profileNow()) {}
+    ~TraceScope() {ring.push(name, start, profileNow() - start);}
+
+private:
+    TraceRing &ring;
+    const char *name;
+    long long start;
+};
+
+//adds the lifetime of a scope to a nanosecond counter
+class StageTimer {
+public:
+    StageTimer(long &t) : total(t), start(profileNow()) {}
+    ~StageTimer() {total += (long)(profileNow() - start);}
+
+private:
+    long &total;
+    long long start;
+};
+
+//Chrome trace-event JSON, one track per ring, for chrome://tracing or Perfetto
+bool writeChromeTrace(const std::string &filename, const std::vector<const TraceRing *> &rings) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "cannot open file " << filename << std::endl;
+        return false;
+    }
+
+    long long origin = 0;
+    bool first = true;
+    for (size_t t = 0; t < rings.size(); t++) {
+        for (size_t i = 0; i < rings[t]->size(); i++) {
+            if (first || (*rings[t])[i].start < origin) origin = (*rings[t])[i].start;
+            first = false;
+        }
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    first = true;
+    for (size_t t = 0; t < rings.size(); t++) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t
+            << ", \"args\": {\"name\": \"worker " << t << "\"}}";
+        first = false;
+        for (size_t i = 0; i < rings[t]->size(); i++) {
+            const TraceEvent &e = (*rings[t])[i];
+            out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << t
+                << ", \"ts\": " << (e.start - origin) / 1000.0
+                << ", \"dur\": " << e.duration / 1000.0 << "}";
+        }
+    }
+    out << std::endl << "]}" << std::endl;
+
+    if (!out.good()) {
+        std::cerr << "cannot write trace file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_TRACE(ring, name) TraceScope PROFILE_CONCAT(traceScope, __LINE__)(ring, name)
+#define PROFILE_TIME(total) StageTimer PROFILE_CONCAT(stageTimer, __LINE__)(total)
+#define PROFILE_COUNT(statement) statement
+
+#else
+
+#define PROFILE_TRACE(ring, name)
+#define PROFILE_TIME(total)
+#define PROFILE_COUNT(statement)
+
+#endif
+
+#endif /* profiler_h */
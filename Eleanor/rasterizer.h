@@ -0,0 +1,193 @@
+//
+//  rasterizer.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef rasterizer_h
+#define rasterizer_h
+
+#include <cmath>
+#include <algorithm>
+
+#include "math/math.h"
+#include "math/simd.h"
+
+const int SUBPIXEL_BITS = 4;
+const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+//upper bound of varyings floats per vertex, sizes the raster stage's buffers
+const int MAX_VARYINGS = 16;
+typedef float VertexVaryings[MAX_VARYINGS];
+
+//vertices further out than this overflow the 32-bit edge stepping,
+//the clipper keeps triangles inside it
+const float GUARD_BAND = 4096.0f;
+
+#ifdef SIMD_WIDTH
+//Pixel blocks are two rows high and made of 2x2 quads. Lanes 0-3 are the quad
+//(x,y) (x+1,y) (x,y+1) (x+1,y+1), lanes 4-7 the quad to the right of it.
+const int BLOCK_SIZE = SIMD_WIDTH;
+const int BLOCK_W = SIMD_WIDTH / 2;
+const int BLOCK_H = 2;
+
+inline int blockLaneX(int i) {return (i>>2)*2 + (i&1);}
+inline int blockLaneY(int i) {return (i>>1)&1;}
+#endif
+
+enum RasterSetup {
+    RASTER_DRAW,
+    RASTER_SKIP
+};
+
+//Edge functions of a screen-space triangle in 28.4 fixed point, set up once and
+//then stepped per pixel and per row. Pixels are sampled at integer coordinates.
+//Edge k is the one opposite vertex k, so its value is the (unnormalized)
+//barycentric weight of vertex k.
+struct TriangleSetup {
+    int minX, minY, maxX, maxY;
+
+    int e[3];       //edge values at (minX, minY), top-left bias already applied
+    int dx[3];      //step to the next pixel in the row
+    int dy[3];      //step to the next row
+
+    int order[3];   //setup vertex i is input vertex order[i]
+    float invW[3];
+
+    float z0;       //screen-space depth plane at (minX, minY)
+    float dzdx;
+    float dzdy;
+
+    //barycentrics of each setup vertex in the source face, the unit vectors
+    //unless the clipper cut this triangle out of a larger one
+    vector3 source[3];
+
+    RasterSetup setup(const vector3 *pts, const float *w, int x0, int y0, int x1, int y1);
+
+    //bcMap holds the source face barycentrics of each input vertex
+    void mapToSource(const vector3 *bcMap) {
+        for (int i = 0; i < 3; i++) source[i] = bcMap[order[i]];
+    }
+
+    //perspective-correct weights of the setup vertices
+    inline void weights(const int *ee, float *w) const {
+        float f0 = ee[0] * invW[0];
+        float f1 = ee[1] * invW[1];
+        float f2 = ee[2] * invW[2];
+        float r = 1.0f / (f0 + f1 + f2);
+        w[0] = f0 * r;
+        w[1] = f1 * r;
+        w[2] = f2 * r;
+    }
+
+    //perspective-correct barycentrics in the source face
+    inline void barycentric(const int *ee, vector3 &bc) const {
+        float w[3];
+        weights(ee, w);
+        toSource(w, bc);
+    }
+
+    inline void toSource(const float *w, vector3 &bc) const {
+        for (int k = 0; k < 3; k++) {
+            bc[k] = source[0][k]*w[0] + source[1][k]*w[1] + source[2][k]*w[2];
+        }
+    }
+};
+
+//Varyings at the setup vertices, interpolated with the rasterizer's weights.
+struct TriangleVaryings {
+    int count;
+    VertexVaryings v[3];
+
+    //face points to the varyings of the source face's vertices
+    void setup(const TriangleSetup &ts, const float *const *face, int n) {
+        count = n;
+        for (int j = 0; j < 3; j++) {
+            const vector3 &b = ts.source[j];
+            for (int k = 0; k < n; k++) {
+                v[j][k] = b.x*face[0][k] + b.y*face[1][k] + b.z*face[2][k];
+            }
+        }
+    }
+
+    //writes component k to out[k*stride]
+    inline void interpolate(const float *w, float *out, int stride) const {
+        for (int k = 0; k < count; k++) {
+            out[k*stride] = v[0][k]*w[0] + v[1][k]*w[1] + v[2][k]*w[2];
+        }
+    }
+};
+
+static inline int floorDiv(long long a, int b) {
+    long long q = a / b;
+    if ((a % b != 0) && (a < 0)) q--;
+    return (int)q;
+}
+
+RasterSetup TriangleSetup::setup(const vector3 *pts, const float *w, int x0, int y0, int x1, int y1) {
+    for (int i = 0; i < 3; i++) {
+        if (!(std::abs(pts[i].x) <= GUARD_BAND && std::abs(pts[i].y) <= GUARD_BAND)) return RASTER_SKIP;
+    }
+
+    int X[3], Y[3];
+    for (int i = 0; i < 3; i++) {
+        X[i] = (int)lroundf(pts[i].x * SUBPIXEL_ONE);
+        Y[i] = (int)lroundf(pts[i].y * SUBPIXEL_ONE);
+        order[i] = i;
+        source[i] = vector3(i == 0, i == 1, i == 2);
+    }
+
+    long long area = (long long)(X[1]-X[0])*(Y[2]-Y[0]) - (long long)(Y[1]-Y[0])*(X[2]-X[0]);
+    if (area == 0) return RASTER_SKIP;
+    if (area < 0) {
+        //make the winding counter-clockwise so inside is positive on every edge
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        order[1] = 2;
+        order[2] = 1;
+        std::swap(source[1], source[2]);
+    }
+
+    minX = std::max(x0, floorDiv(std::min(X[0], std::min(X[1], X[2])) + SUBPIXEL_ONE - 1, SUBPIXEL_ONE));
+    minY = std::max(y0, floorDiv(std::min(Y[0], std::min(Y[1], Y[2])) + SUBPIXEL_ONE - 1, SUBPIXEL_ONE));
+    maxX = std::min(x1, floorDiv(std::max(X[0], std::max(X[1], X[2])), SUBPIXEL_ONE));
+    maxY = std::min(y1, floorDiv(std::max(Y[0], std::max(Y[1], Y[2])), SUBPIXEL_ONE));
+    if (minX > maxX || minY > maxY) return RASTER_SKIP;
+
+    long long px = (long long)minX * SUBPIXEL_ONE;
+    long long py = (long long)minY * SUBPIXEL_ONE;
+    long long sum = 0;
+    for (int k = 0; k < 3; k++) {
+        int a = (k+1)%3;
+        int b = (k+2)%3;
+        int edx = X[b] - X[a];
+        int edy = Y[b] - Y[a];
+
+        //top-left rule: pixels exactly on a top or left edge belong to this triangle
+        bool topLeft = (edy == 0 && edx < 0) || edy < 0;
+        long long ev = (long long)edx*(py - Y[a]) - (long long)edy*(px - X[a]) + (topLeft ? 0 : -1);
+
+        //every step is a multiple of SUBPIXEL_ONE, so drop those bits to fit in 32 bits
+        e[k] = floorDiv(ev, SUBPIXEL_ONE);
+        dx[k] = -edy;
+        dy[k] = edx;
+        sum += e[k];
+    }
+
+    float z[3];
+    for (int i = 0; i < 3; i++) {
+        invW[i] = 1.0f / w[order[i]];
+        z[i] = pts[order[i]].z;
+    }
+
+    float invSum = 1.0f / (float)sum;
+    z0 = (e[0]*z[0] + e[1]*z[1] + e[2]*z[2]) * invSum;
+    dzdx = (dx[0]*z[0] + dx[1]*z[1] + dx[2]*z[2]) * invSum;
+    dzdy = (dy[0]*z[0] + dy[1]*z[1] + dy[2]*z[2]) * invSum;
+
+    return RASTER_DRAW;
+}
+
+#endif /* rasterizer_h */
@@ -0,0 +1,125 @@
+//
+//  renderstats.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef renderstats_h
+#define renderstats_h
+
+#include <iostream>
+
+//Per-frame pipeline counters. Raster workers keep their own copy and the
+//renderer sums them up after every model() call.
+struct RenderStats {
+    long verticesShaded = 0;
+    
+    long batchesDrawn = 0;
+    long textureBinds = 0;      //runs of batches drawn with the same textures
+    
+    long trianglesSubmitted = 0;
+    long trianglesCulledFrustum = 0;
+    long trianglesCulledDegenerate = 0;
+    long trianglesCulledFacing = 0;
+    long trianglesClipped = 0;
+    long trianglesRasterized = 0;
+    
+    long hizTrianglesRejected = 0;     //faces hi-z rejected in every tile they were binned to
+    long hizBlocksRejected = 0;
+    long fragmentsShaded = 0;
+    
+    long framePixels = 0;
+    
+    //only counted with ELEANOR_PROFILE
+    long pixelsTested = 0;      //covered and not rejected by hi-z, reaching the depth test
+    long pixelsPassed = 0;      //written to the depth buffer
+    
+    //Stage times with ELEANOR_PROFILE, in ns summed over the raster threads.
+    //Each one includes the stages listed after it, except resolveNs.
+    long vertexNs = 0;          //vertex shader
+    long triangleNs = 0;        //everything per triangle: setup, hi-z, raster
+    long rasterNs = 0;          //edge and depth loop
+    long shadeNs = 0;           //fragment shader called from the raster loop
+    long resolveNs = 0;         //fragment shader of the visibility buffer resolve, after the raster loop
+    
+    void reset() {
+        *this = RenderStats();
+    }
+    
+    void add(const RenderStats &s) {
+        verticesShaded += s.verticesShaded;
+        batchesDrawn += s.batchesDrawn;
+        textureBinds += s.textureBinds;
+        trianglesSubmitted += s.trianglesSubmitted;
+        trianglesCulledFrustum += s.trianglesCulledFrustum;
+        trianglesCulledDegenerate += s.trianglesCulledDegenerate;
+        trianglesCulledFacing += s.trianglesCulledFacing;
+        trianglesClipped += s.trianglesClipped;
+        trianglesRasterized += s.trianglesRasterized;
+        hizTrianglesRejected += s.hizTrianglesRejected;
+        hizBlocksRejected += s.hizBlocksRejected;
+        fragmentsShaded += s.fragmentsShaded;
+        pixelsTested += s.pixelsTested;
+        pixelsPassed += s.pixelsPassed;
+        vertexNs += s.vertexNs;
+        triangleNs += s.triangleNs;
+        rasterNs += s.rasterNs;
+        shadeNs += s.shadeNs;
+        resolveNs += s.resolveNs;
+    }
+    
+    long trianglesCulled() {
+        return trianglesCulledFrustum + trianglesCulledDegenerate + trianglesCulledFacing;
+    }
+    
+    //time spent in each stage alone
+    long setupNs() {
+        return triangleNs - rasterNs;
+    }
+    
+    long rasterOnlyNs() {
+        return rasterNs - shadeNs;
+    }
+    
+    long fragmentNs() {
+        return shadeNs + resolveNs;
+    }
+    
+    //depth writes per pixel of the frame
+    float overdraw() {
+        return framePixels ? (float)pixelsPassed / framePixels : 0.0f;
+    }
+    
+    void dump() {
+        std::cout << "vertex shader invocations: " << verticesShaded
+                  << " for " << trianglesSubmitted << " faces";
+        if (trianglesSubmitted) std::cout << " (" << (float)verticesShaded / trianglesSubmitted << " per face)";
+        std::cout << std::endl;
+        std::cout << "batches: " << batchesDrawn
+                  << " texture binds: " << textureBinds << std::endl;
+        std::cout << "triangles submitted: " << trianglesSubmitted
+                  << " culled: " << trianglesCulled()
+                  << " (frustum " << trianglesCulledFrustum
+                  << ", degenerate " << trianglesCulledDegenerate
+                  << ", facing " << trianglesCulledFacing << ")"
+                  << " clipped: " << trianglesClipped
+                  << " rasterized: " << trianglesRasterized << std::endl;
+        std::cout << "hi-z rejected triangles: " << hizTrianglesRejected
+                  << " blocks: " << hizBlocksRejected << std::endl;
+        std::cout << "fragments shaded: " << fragmentsShaded << std::endl;
+#ifdef ELEANOR_PROFILE
+        std::cout << "pixels tested: " << pixelsTested
+                  << " passed: " << pixelsPassed
+                  << " overdraw: " << overdraw() << std::endl;
+        std::cout << "vertex " << vertexNs / 1e6 << " ms"
+                  << ", triangle setup " << setupNs() / 1e6 << " ms"
+                  << ", raster " << rasterOnlyNs() / 1e6 << " ms"
+                  << ", fragment " << fragmentNs() / 1e6 << " ms"
+                  << " (summed over threads)" << std::endl;
+#endif
+    }
+};
+
+#endif /* renderstats_h */
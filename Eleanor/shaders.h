@@ -15,7 +15,11 @@
 #include "ModelLoader.h"
 #include "transform.h"
 #include "camera.h"
+#include "rasterizer.h"
 
+//Shaders keep only per-frame uniforms in members, set up in init(). Per-vertex
+//outputs go through varyings, which the rasterizer interpolates, so a single
+//shader object can be shared by every raster thread.
 struct IShader {
     
     Model *modelObj;
@@ -23,15 +27,125 @@ struct IShader {
     vector3 *light;
     Camera *camera;
     
+    virtual ~IShader() {}
+    
     virtual void init() {};
-    virtual vector4 vertex(int nface, int nthvert) = 0;
-    virtual void fragment(vector3 bc, TGAColor &c) = 0;
+    
+    //true when vertex outputs depend only on the vertex's index triple and not
+    //on the face, so a vertex shared by several faces is processed once
+    virtual bool sharedVertices() const {return false;}
+    
+    //number of floats processVertex() writes
+    virtual int varyingCount() const = 0;
+    virtual vector4 processVertex(int nface, int nthvert, float *varyings) const = 0;
+    
+    //Process count vertices given by their face corner 3*f+k, varyings are
+    //packed varyingCount() floats apart.
+    virtual void processVertices(const int *corners, int count, vector4 *positions, float *varyings) const = 0;
+    
+    //Shade count pixels, only lanes with their bit set in mask. Interpolated
+    //varyings are SoA: component n of lane i is varyings[n*stride + i].
+    //With quads, count is a multiple of 4 and lanes 4q..4q+3 are the pixels
+    //(x,y) (x+1,y) (x,y+1) (x+1,y+1) of a 2x2 quad, masked out lanes included,
+    //and the fragments get the varyings' screen-space derivatives. Without,
+    //the derivatives are zero.
+    virtual void shadeBlock(const float *varyings, int stride, int count, unsigned int mask, bool quads, TGAColor *c) const = 0;
 };
 
-struct TestShader : public IShader {
+//Base of the concrete shaders. Varyings is a plain struct of floats, and
+//Derived implements
+//    vector4 vertex(int nface, int nthvert, Varyings &out) const;
+//    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const;
+//where dx and dy are the differences of in to its right and lower neighbour
+//in the pixel's quad. The overrides are final, so a pipeline instantiated for
+//Derived calls them directly.
+template <class Derived, class V>
+struct TypedShader : public IShader {
+    
+    typedef V Varyings;
+    static const int VARYINGS = sizeof(V) / sizeof(float);
+    static_assert(VARYINGS <= MAX_VARYINGS, "too many varyings");
     
-    vector2 uvs[3];
-    vector3 normals[3];
+    virtual int varyingCount() const final {
+        return VARYINGS;
+    }
+    
+    virtual vector4 processVertex(int nface, int nthvert, float *varyings) const final {
+        return static_cast<const Derived *>(this)->vertex(nface, nthvert, *reinterpret_cast<V *>(varyings));
+    }
+    
+    //one vertex at a time, shaders with a batched vertex stage override this
+    virtual void processVertices(const int *corners, int count, vector4 *positions, float *varyings) const {
+        for (int i = 0; i < count; i++) {
+            positions[i] = processVertex(corners[i] / 3, corners[i] % 3, varyings + i*VARYINGS);
+        }
+    }
+    
+    virtual void shadeBlock(const float *varyings, int stride, int count, unsigned int mask, bool quads, TGAColor *c) const final {
+        //coarse derivatives, shared by the four pixels of a quad
+        float dx[VARYINGS], dy[VARYINGS];
+        if (!quads) {
+            for (int n = 0; n < VARYINGS; n++) dx[n] = dy[n] = 0.0f;
+        }
+        for (int i = 0; i < count; i++) {
+            if (quads && (i & 3) == 0) {
+                if (!(mask & (0xfu << i))) {
+                    i += 3;
+                    continue;
+                }
+                for (int n = 0; n < VARYINGS; n++) {
+                    const float *v = varyings + n*stride + i;
+                    dx[n] = v[1] - v[0];
+                    dy[n] = v[2] - v[0];
+                }
+            }
+            if (!(mask & (1u << i))) continue;
+            V in;
+            float *f = reinterpret_cast<float *>(&in);
+            for (int n = 0; n < VARYINGS; n++) f[n] = varyings[n*stride + i];
+            static_cast<const Derived *>(this)->fragment(in, *reinterpret_cast<const V *>(dx), *reinterpret_cast<const V *>(dy), c[i]);
+        }
+    }
+};
+
+struct NormalVaryings {
+    vector2 uv;
+    vector3 normal;
+};
+
+//Batched vertex stage shared by the NormalVaryings shaders: positions go through
+//MVP and normals through MVP_IT with the SoA kernel of matrix44, which gives
+//the same results as their one-vertex vertex().
+inline void normalVaryingsBatch(Model *modelObj, Transforms *transforms, const int *corners, int count, vector4 *positions, NormalVaryings *out) {
+    const int BATCH = 64;
+    float px[BATCH], py[BATCH], pz[BATCH];
+    float nx[BATCH], ny[BATCH], nz[BATCH];
+    float cx[BATCH], cy[BATCH], cz[BATCH], cw[BATCH];
+    float tx[BATCH], ty[BATCH], tz[BATCH];
+    
+    for (int start = 0; start < count; start += BATCH) {
+        int n = std::min(BATCH, count - start);
+        for (int i = 0; i < n; i++) {
+            int c = corners[start + i];
+            int vid = modelObj->getIndex(c / 3, c % 3);
+            vector3 pos = modelObj->getVertex(vid);
+            vector3 normal = modelObj->getNormal(vid);
+            px[i] = pos.x; py[i] = pos.y; pz[i] = pos.z;
+            nx[i] = normal.x; ny[i] = normal.y; nz[i] = normal.z;
+            out[start + i].uv = modelObj->getUV(vid);
+        }
+        
+        transforms->MVP.transform(px, py, pz, 1.0f, cx, cy, cz, cw, n);
+        transforms->MVP_IT.transform(nx, ny, nz, 0.0f, tx, ty, tz, NULL, n);
+        
+        for (int i = 0; i < n; i++) {
+            positions[start + i] = vector4(cx[i], cy[i], cz[i], cw[i]);
+            out[start + i].normal = vector3(tx[i], ty[i], tz[i]);
+        }
+    }
+}
+
+struct TestShader final : public TypedShader<TestShader, NormalVaryings> {
     
     vector3 l;
     
@@ -39,44 +153,40 @@ struct TestShader : public IShader {
         l = matrix33(transforms->MVP) * (*light);
     }
     
-    virtual vector4 vertex(int nface, int nthvert) {
-        tinyobj::index_t idx = modelObj->getIndex(nface, nthvert);
+    virtual bool sharedVertices() const {return true;}
+    
+    virtual void processVertices(const int *corners, int count, vector4 *positions, float *varyings) const {
+        normalVaryingsBatch(modelObj, transforms, corners, count, positions, reinterpret_cast<NormalVaryings *>(varyings));
+    }
+    
+    vector4 vertex(int nface, int nthvert, Varyings &out) const {
+        int vid = modelObj->getIndex(nface, nthvert);
         
-        vector4 pos = vector4(modelObj->getVertex(idx.vertex_index), 1.0f);
+        vector4 pos = vector4(modelObj->getVertex(vid), 1.0f);
         vector4 gl_Position = transforms->MVP * pos;
         
-        vector3 normal = modelObj->getNormal(idx.normal_index);
+        vector3 normal = modelObj->getNormal(vid);
         
         vector4 n = vector4(normal, 0.0f);
         vector4 nn = transforms->MVP_IT * n;
-        normals[nthvert] = vector3(nn.x, nn.y, nn.z);
+        out.normal = vector3(nn.x, nn.y, nn.z);
         
-        uvs[nthvert] = modelObj->getUV(idx.texcoord_index);
+        out.uv = modelObj->getUV(vid);
 
         return gl_Position;
     }
     
-    virtual void fragment(vector3 bc, TGAColor &c) {
-        vector3 n;
-        n.x = normals[0].x*bc.x + normals[1].x*bc.y + normals[2].x*bc.z;
-        n.y = normals[0].y*bc.x + normals[1].y*bc.y + normals[2].y*bc.z;
-        n.z = normals[0].z*bc.x + normals[1].z*bc.y + normals[2].z*bc.z;
+    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const {
+        vector3 n = in.normal;
         n.normalize();
         
-        vector2 uv;
-        uv.x = uvs[0].x*bc.x + uvs[1].x*bc.y + uvs[2].x*bc.z;
-        uv.y = uvs[0].y*bc.x + uvs[1].y*bc.y + uvs[2].y*bc.z;
-        
         float diff = std::max(0.0f, n * l);
         
-        c = modelObj->getDiffuse(uv.x, uv.y)*diff;
+        c = modelObj->getDiffuse(in.uv, dx.uv, dy.uv)*diff;
     }
 };
 
-struct PhongShader : public IShader {
-    
-    vector2 uvs[3];
-    vector3 normals[3];
+struct PhongShader final : public TypedShader<PhongShader, NormalVaryings> {
     
     vector3 l;
     
@@ -84,52 +194,54 @@ struct PhongShader : public IShader {
         l = matrix33(transforms->MVP) * (*light);
     }
     
-    virtual vector4 vertex(int nface, int nthvert) {
-        tinyobj::index_t idx = modelObj->getIndex(nface, nthvert);
+    virtual bool sharedVertices() const {return true;}
+    
+    virtual void processVertices(const int *corners, int count, vector4 *positions, float *varyings) const {
+        normalVaryingsBatch(modelObj, transforms, corners, count, positions, reinterpret_cast<NormalVaryings *>(varyings));
+    }
+    
+    vector4 vertex(int nface, int nthvert, Varyings &out) const {
+        int vid = modelObj->getIndex(nface, nthvert);
         
-        vector4 pos = vector4(modelObj->getVertex(idx.vertex_index), 1.0f);
+        vector4 pos = vector4(modelObj->getVertex(vid), 1.0f);
         vector4 gl_Position = transforms->MVP * pos;
         
-        vector3 normal = modelObj->getNormal(idx.normal_index);
+        vector3 normal = modelObj->getNormal(vid);
         
         vector4 n = vector4(normal, 0.0f);
         vector4 nn = transforms->MVP_IT * n;
-        normals[nthvert] = vector3(nn.x, nn.y, nn.z);
+        out.normal = vector3(nn.x, nn.y, nn.z);
         
-        uvs[nthvert] = modelObj->getUV(idx.texcoord_index);
+        out.uv = modelObj->getUV(vid);
         
         return gl_Position;
     }
     
-    virtual void fragment(vector3 bc, TGAColor &c) {
-        vector3 n;
-        n.x = normals[0].x*bc.x + normals[1].x*bc.y + normals[2].x*bc.z;
-        n.y = normals[0].y*bc.x + normals[1].y*bc.y + normals[2].y*bc.z;
-        n.z = normals[0].z*bc.x + normals[1].z*bc.y + normals[2].z*bc.z;
+    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const {
+        vector3 n = in.normal;
         n.normalize();
         
-        vector2 uv;
-        uv.x = uvs[0].x*bc.x + uvs[1].x*bc.y + uvs[2].x*bc.z;
-        uv.y = uvs[0].y*bc.x + uvs[1].y*bc.y + uvs[2].y*bc.z;
+        vector2 uv = in.uv;
         
-        c = modelObj->getDiffuse(uv.x, uv.y);
+        c = modelObj->getDiffuse(uv, dx.uv, dy.uv);
         
         float diff = std::max(0.f, n*l);
         
         vector3 r = (n*(n*l*2.f) - l).normalize();
-        float spec = std::pow(std::max(r.z, 0.0f), modelObj->getSpecular(uv.x, uv.y));
+        float spec = std::pow(std::max(r.z, 0.0f), modelObj->getSpecular(uv, dx.uv, dy.uv));
         
         for (int i=0; i<3; i++) c.bgra[i] = std::min<float>(5 + c.bgra[i]*(diff + .6*spec), 255);
     }
 };
 
-struct TangentShader : public IShader {
-    
-    vector2 uvs[3];
-    
-    vector3 tangentLightPoss[3];
-    vector3 tangentViewPoss[3];
-    vector3 tangentFragPoss[3];
+struct TangentVaryings {
+    vector2 uv;
+    vector3 tangentLightPos;
+    vector3 tangentViewPos;
+    vector3 tangentFragPos;
+};
+
+struct TangentShader final : public TypedShader<TangentShader, TangentVaryings> {
     
     vector3 l;
     
@@ -137,15 +249,15 @@ struct TangentShader : public IShader {
         l = vector3(10,10,10);
     }
     
-    virtual vector4 vertex(int nface, int nthvert) {
-        tinyobj::index_t idx = modelObj->getIndex(nface, nthvert);
+    vector4 vertex(int nface, int nthvert, Varyings &out) const {
+        int vid = modelObj->getIndex(nface, nthvert);
         
-        vector3 pos = modelObj->getVertex(idx.vertex_index);
+        vector3 pos = modelObj->getVertex(vid);
         vector4 fragPos = transforms->model * vector4(pos, 1.0f);
         
-        vector3 normal = modelObj->getNormal(idx.normal_index);
+        vector3 normal = modelObj->getNormal(vid);
         
-        uvs[nthvert] = modelObj->getUV(idx.texcoord_index);
+        out.uv = modelObj->getUV(vid);
         
         matrix33 normalMatrix = matrix33(transforms->model);
         normalMatrix.inverse();
@@ -166,47 +278,30 @@ struct TangentShader : public IShader {
         matrix33 TBN = matrix33(T, B, N);
         TBN.transpose();
         
-        tangentLightPoss[nthvert] = TBN * l;//(*light);
-        tangentViewPoss[nthvert] = TBN * camera->Position;
-        tangentFragPoss[nthvert] = TBN * vector3(fragPos.x,fragPos.y,fragPos.z);
+        out.tangentLightPos = TBN * l;//(*light);
+        out.tangentViewPos = TBN * camera->Position;
+        out.tangentFragPos = TBN * vector3(fragPos.x,fragPos.y,fragPos.z);
         
         vector4 gl_Position = transforms->MVP * vector4(pos, 1.0f);
         return gl_Position;
     }
     
-    virtual void fragment(vector3 bc, TGAColor &c) {
+    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const {
         
-        vector2 uv;
-        uv.x = uvs[0].x*bc.x + uvs[1].x*bc.y + uvs[2].x*bc.z;
-        uv.y = uvs[0].y*bc.x + uvs[1].y*bc.y + uvs[2].y*bc.z;
+        vector2 uv = in.uv;
         
-        vector3 normal = modelObj->getNormal(uv.x, uv.y);
-        normal.normalize();
+        vector3 normal = modelObj->getNormal(uv, dx.uv, dy.uv);
         
-        TGAColor color = modelObj->getDiffuse(uv.x, uv.y);
+        TGAColor color = modelObj->getDiffuse(uv, dx.uv, dy.uv);
         TGAColor ambient = color * 0.1;
         
-        vector3 tangentLightPos;
-        tangentLightPos.x = tangentLightPoss[0].x*bc.x + tangentLightPoss[1].x*bc.y + tangentLightPoss[2].x*bc.z;
-        tangentLightPos.y = tangentLightPoss[0].y*bc.x + tangentLightPoss[1].y*bc.y + tangentLightPoss[2].y*bc.z;
-        tangentLightPos.z = tangentLightPoss[0].z*bc.x + tangentLightPoss[1].z*bc.y + tangentLightPoss[2].z*bc.z;
-        vector3 tangentViewPos;
-        tangentViewPos.x = tangentViewPoss[0].x*bc.x + tangentViewPoss[1].x*bc.y + tangentViewPoss[2].x*bc.z;
-        tangentViewPos.y = tangentViewPoss[0].y*bc.x + tangentViewPoss[1].y*bc.y + tangentViewPoss[2].y*bc.z;
-        tangentViewPos.z = tangentViewPoss[0].z*bc.x + tangentViewPoss[1].z*bc.y + tangentViewPoss[2].z*bc.z;
-        vector3 tangentFragPos;
-        tangentFragPos.x = tangentFragPoss[0].x*bc.x + tangentFragPoss[1].x*bc.y + tangentFragPoss[2].x*bc.z;
-        tangentFragPos.y = tangentFragPoss[0].y*bc.x + tangentFragPoss[1].y*bc.y + tangentFragPoss[2].y*bc.z;
-        tangentFragPos.z = tangentFragPoss[0].z*bc.x + tangentFragPoss[1].z*bc.y + tangentFragPoss[2].z*bc.z;
-        
-        
-        vector3 lightDir = tangentLightPos-tangentFragPos;
+        vector3 lightDir = in.tangentLightPos-in.tangentFragPos;
 
         float diff = std::max(0.0f, lightDir*normal);
         
         TGAColor diffuse = color * diff;
         
-        vector3 viewDir = tangentViewPos-tangentFragPos;
+        vector3 viewDir = in.tangentViewPos-in.tangentFragPos;
 
         //vector3 reflectDir = reflect(-lightDir, normal);
         vector3 halfwayDir = lightDir + viewDir;
@@ -219,11 +314,18 @@ struct TangentShader : public IShader {
     }
 };
 
-struct TangentNormalShader : IShader {
-    vector2 uvs[3];
-    vector3 normals[3];
-    
-    vector3 ndc_tri[3];
+//edges and uv deltas are per face, every vertex writes the same values so
+//interpolation leaves them constant
+struct TangentNormalVaryings {
+    vector2 uv;
+    vector3 normal;
+    vector3 edge1;
+    vector3 edge2;
+    vector2 du;
+    vector2 dv;
+};
+
+struct TangentNormalShader final : TypedShader<TangentNormalShader, TangentNormalVaryings> {
     
     vector3 l;
     
@@ -231,73 +333,77 @@ struct TangentNormalShader : IShader {
         l = matrix33(transforms->MVP) * (*light);
     }
     
-    virtual vector4 vertex(int nface, int nthvert) {
-        tinyobj::index_t idx = modelObj->getIndex(nface, nthvert);
-        
-        vector4 pos = vector4(modelObj->getVertex(idx.vertex_index), 1.0f);
-        vector4 gl_Position = transforms->MVP * pos;
-        
-        vector3 normal = modelObj->getNormal(idx.normal_index);
+    vector4 vertex(int nface, int nthvert, Varyings &out) const {
+        vector3 ndc_tri[3];
+        vector2 uvs[3];
+        vector4 gl_Position;
+        for (int k = 0; k < 3; k++) {
+            int vid = modelObj->getIndex(nface, k);
+            vector4 p = transforms->MVP * vector4(modelObj->getVertex(vid), 1.0f);
+            ndc_tri[k] = vector3(p.x/p.w, p.y/p.w, p.z/p.w);
+            uvs[k] = modelObj->getUV(vid);
+            if (k == nthvert) gl_Position = p;
+        }
+        
+        int vid = modelObj->getIndex(nface, nthvert);
+        vector3 normal = modelObj->getNormal(vid);
         
         vector4 n = vector4(normal, 0.0f);
         vector4 nn = transforms->MVP_IT * n;
-        normals[nthvert] = vector3(nn.x, nn.y, nn.z);
+        out.normal = vector3(nn.x, nn.y, nn.z);
         
-        uvs[nthvert] = modelObj->getUV(idx.texcoord_index);
+        out.uv = uvs[nthvert];
         
-        ndc_tri[nthvert] = vector3(gl_Position.x/gl_Position.w, gl_Position.y/gl_Position.w, gl_Position.z/gl_Position.w);
+        out.edge1 = ndc_tri[1] - ndc_tri[0];
+        out.edge2 = ndc_tri[2] - ndc_tri[0];
+        out.du = vector2(uvs[1].x-uvs[0].x, uvs[2].x-uvs[0].x);
+        out.dv = vector2(uvs[1].y-uvs[0].y, uvs[2].y-uvs[0].y);
         
         return gl_Position;
     }
     
-    virtual void fragment(vector3 bc, TGAColor &c) {
-        vector3 n;
-        n.x = normals[0].x*bc.x + normals[1].x*bc.y + normals[2].x*bc.z;
-        n.y = normals[0].y*bc.x + normals[1].y*bc.y + normals[2].y*bc.z;
-        n.z = normals[0].z*bc.x + normals[1].z*bc.y + normals[2].z*bc.z;
+    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const {
+        vector3 n = in.normal;
         n.normalize();
         
-        vector2 uv;
-        uv.x = uvs[0].x*bc.x + uvs[1].x*bc.y + uvs[2].x*bc.z;
-        uv.y = uvs[0].y*bc.x + uvs[1].y*bc.y + uvs[2].y*bc.z;
-        
-        vector3 a = ndc_tri[1] - ndc_tri[0];
-        vector3 b = ndc_tri[2] - ndc_tri[0];
+        vector2 uv = in.uv;
         
-        matrix33 A = matrix33(a, b, n);
+        matrix33 A = matrix33(in.edge1, in.edge2, n);
         A.transpose();
         A.inverse();
         
-        vector3 i = A * vector3(uvs[1].x-uvs[0].x, uvs[2].x-uvs[0].x, 0);
-        vector3 j = A * vector3(uvs[1].y-uvs[0].y, uvs[2].y-uvs[0].y, 0);
+        vector3 i = A * vector3(in.du.x, in.du.y, 0);
+        vector3 j = A * vector3(in.dv.x, in.dv.y, 0);
         matrix33 B = matrix33(i, j, n);
         
-        vector3 normal = modelObj->getNormal(uv.x, uv.y);
-        normal.normalize();
+        vector3 normal = modelObj->getNormal(uv, dx.uv, dy.uv);
         
         vector3 N = B * normal;
         N.normalize();
         
         float diff = std::max(0.0f, N * l);
         
-        c = modelObj->getDiffuse(uv.x, uv.y)*diff;
+        c = modelObj->getDiffuse(uv, dx.uv, dy.uv)*diff;
     }
 };
 
-struct TangentAShader : public IShader {
-    
-    vector2 uvs[3];
-    
-    matrix33 TBN;
+struct TangentAVaryings {
+    vector2 uv;
+    vector3 T;
+    vector3 B;
+    vector3 N;
+};
+
+struct TangentAShader final : public TypedShader<TangentAShader, TangentAVaryings> {
     
-    virtual vector4 vertex(int nface, int nthvert) {
-        tinyobj::index_t idx = modelObj->getIndex(nface, nthvert);
+    vector4 vertex(int nface, int nthvert, Varyings &out) const {
+        int vid = modelObj->getIndex(nface, nthvert);
         
-        vector3 pos = modelObj->getVertex(idx.vertex_index);
+        vector3 pos = modelObj->getVertex(vid);
         
-        vector3 normal = modelObj->getNormal(idx.normal_index);
+        vector3 normal = modelObj->getNormal(vid);
         
-        uvs[nthvert] = modelObj->getUV(idx.texcoord_index);
+        out.uv = modelObj->getUV(vid);
         
         matrix33 normalMatrix = matrix33(transforms->model);
         normalMatrix.inverse();
@@ -315,24 +421,24 @@ struct TangentAShader : public IShader {
         vector3 B;
         vector3Cross(B, N, T);
         
-        TBN = matrix33(T, B, N);
+        out.T = T;
+        out.B = B;
+        out.N = N;
         
         vector4 gl_Position = transforms->MVP * vector4(pos, 1.0f);
         return gl_Position;
     }
     
-    virtual void fragment(vector3 bc, TGAColor &c) {
+    void fragment(const Varyings &in, const Varyings &dx, const Varyings &dy, TGAColor &c) const {
         
-        vector2 uv;
-        uv.x = uvs[0].x*bc.x + uvs[1].x*bc.y + uvs[2].x*bc.z;
-        uv.y = uvs[0].y*bc.x + uvs[1].y*bc.y + uvs[2].y*bc.z;
+        vector2 uv = in.uv;
         
-        vector3 normal = modelObj->getNormal(uv.x, uv.y);
-        normal.normalize();
+        vector3 normal = modelObj->getNormal(uv, dx.uv, dy.uv);
         
-        TGAColor color = modelObj->getDiffuse(uv.x, uv.y);
+        TGAColor color = modelObj->getDiffuse(uv, dx.uv, dy.uv);
         TGAColor ambient = color * 0.2;
         
+        matrix33 TBN = matrix33(in.T, in.B, in.N);
         normal = TBN * normal;
         normal.normalize();
         
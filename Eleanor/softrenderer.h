@@ -1,54 +1,231 @@
 //
-//  framebuffer.h
+//  softrenderer.h
 //  Eleanor
 //
 //  Created by cliff on 07/11/2017.
 //  Copyright © 2017 cliff. All rights reserved.
 //
 
-#ifndef framebuffer_h
-#define framebuffer_h
+#ifndef softrenderer_h
+#define softrenderer_h
+
+#include <atomic>
+#include <climits>
 
-#include <SDL2/SDL.h>
 #include "math/math.h"
 #include "ModelLoader.h"
 #include "TGAImage.h"
 #include "shaders.h"
 #include "TransformUtils.h"
+#include "threadpool.h"
+#include "rasterizer.h"
+#include "hizbuffer.h"
+#include "renderstats.h"
+#include "clipper.h"
+#include "framebuffer.h"
+#include "profiler.h"
+
+const int TILE_SIZE = 64;
 
-const float EPSILON = 0.00001f;
+//which winding gets dropped, counter-clockwise on screen is front facing
+enum CullMode {
+    CULL_NONE,
+    CULL_BACK,
+    CULL_FRONT
+};
+
+//state owned by one raster thread
+struct RasterWorker {
+    RenderStats stats;
+    std::vector<int> hizDirty;
+    
+    int face = -1;  //face being rasterized, for the visibility buffer
+    
+#ifdef ELEANOR_PROFILE
+    TraceRing trace;
+#endif
+};
+
+//a face in the bin of a tile, clipped once when it was binned
+struct BinEntry {
+    int face;
+    int polygon;    //first vertex in binPolygons, -1 when the face was not clipped
+    int count;      //vertices of the polygon
+};
 
 class SoftRenderer {
 private:
-    unsigned char *buffer = NULL;
-    int bytespp = 4;
-    float *zbuffer;
+    FrameBuffer frame;
+    int pitch;      //of both frame planes
     int width;
     int height;
     bool _enableZTest = true;
-    float zDefault = 5000.0f;
+    DepthFunc depthFunc = DEPTH_LEQUAL;
+    bool reversedZ = false;
+    float reversedScale, reversedBias;
     matrix44 mViewport;
     
     Transforms *transforms;
     
-    vector3 barycentric(vector3 *pts, vector2 p);
+    bool _enableTiling = true;
+    CullMode cullMode = CULL_BACK;
+    int tilesX, tilesY;
+    ThreadPool *pool = NULL;
+    std::vector<std::vector<BinEntry> > bins;
+    std::vector<ClipVertex> binPolygons;    //the polygons of the binned faces that were clipped
+    std::vector<RasterWorker> workers;
+    
+    HiZBuffer hiz;
+    bool hizGreater = false;    //hi-z was built for a greater depth test at the last clear()
+    
+    //Hi-z outcome of each face of the current model() call, over all the
+    //tiles and fan triangles it was split into. Only a face that was
+    //rejected everywhere it was tested counts as a rejected triangle.
+    enum {HIZ_REJECTED = 1, HIZ_PASSED = 2};
+    std::atomic<unsigned char> *hizFaces = NULL;
+    int hizFaceCapacity = 0;
+    RenderStats stats;
+    
+    //visibility buffer: face and the first two perspective barycentrics per pixel
+    bool _enableVisibility = false;
+    int *visId;
+    float *visBc;
+    
+    Clipper clipper;
+    
+    //post-transform vertices of the current model() call
+    std::vector<vector4> vertexPositions;
+    std::vector<float> vertexVaryings;
+    int vertexStride = 0;
+    const uint32_t *cornerVertices = NULL;  //vertex of face corner 3*f+k, NULL when every corner has its own
+    
     void drawLine(vector4 start, vector4 end, TGAColor &color);
     
+    int clipAndCull(vector4 *pts, ClipVertex *poly, RenderStats &st);
+    void toScreen(vector4 *in_pts, vector3 *pts);
+    
+    //The raster pipeline is instantiated per shader type. With a concrete
+    //shader the vertex and fragment calls are direct and can be inlined,
+    //with IShader they stay virtual.
+    template <class Shader>
+    void drawPolygon(ClipVertex *poly, int n, const float **varyings, Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1);
+    template <class Shader>
+    void triangle(vector4 *pts, const float **varyings, Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1, const vector3 *bcMap);
+    template <class Shader>
+    void rasterizeScalar(TriangleSetup &ts, TriangleVaryings &tv, Shader &shader, RasterWorker &worker, int zmin);
+#ifdef SIMD_WIDTH
+    template <class Shader>
+    void rasterizeBlocks(TriangleSetup &ts, TriangleVaryings &tv, Shader &shader, RasterWorker &worker, int zmin);
+#endif
+    template <class Shader>
+    void processVertices(Model &modelObj, Shader &shader);
+    void fetchFace(int face, vector4 *pts, const float **varyings);
+    void binFaces(Model &modelObj);
+    int bindBatches(Model &modelObj, int batch, int &firstFace, int &lastFace);
+    template <class Shader>
+    void modelTiled(Model &modelObj, Shader &shader);
+    template <class Shader>
+    void resolveVisibility(Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1, int firstFace, int lastFace);
+    void weightPlanes(const vector4 *pts, float *ax, float *ay, float *a0);
+    
+    //hi-z only helps ordered depth tests of the direction it was built for
+    bool hizActive() {
+        if (!_enableZTest) return false;
+        if (depthFunc == DEPTH_LESS || depthFunc == DEPTH_LEQUAL) return !hizGreater;
+        if (depthFunc == DEPTH_GREATER || depthFunc == DEPTH_GEQUAL) return hizGreater;
+        return false;
+    }
+    
+    int hizKey(int key) {
+        return hizGreater ? -key : key;
+    }
+    
+    void resetHizFaces(int faceCount);
+    void countHizFaces(int faceCount);
+    
+    void markHizFace(RasterWorker &worker, unsigned char outcome) {
+        //a triangle drawn outside of model() is a face of its own
+        if (worker.face < 0) {
+            if (outcome == HIZ_REJECTED) worker.stats.hizTrianglesRejected++;
+            return;
+        }
+        std::atomic<unsigned char> &f = hizFaces[worker.face];
+        if (!(f.load(std::memory_order_relaxed) & outcome)) f.fetch_or(outcome, std::memory_order_relaxed);
+    }
+    
+    //a triangle drawn outside of model() has no face id for resolveVisibility(),
+    //so it is shaded as it is rasterized even with the visibility buffer on
+    bool deferShading(const RasterWorker &worker) const {
+        return _enableVisibility && worker.face >= 0;
+    }
+    
+    void setVisibility(int x, int y, int face, const vector3 &bc) {
+        int i = x + y*width;
+        visId[i] = face;
+        visBc[2*i] = bc.x;
+        visBc[2*i+1] = bc.y;
+    }
+    
 public:
-    SoftRenderer(int w, int h) {
+    SoftRenderer(int w, int h) : frame(w, h, TILE_SIZE) {
         width = w;
         height = h;
         
         mViewport = viewport(0, 0, width, height);
+        clipper.setViewport(width, height);
+        
+        pitch = frame.getPitch();
+        
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        bins.resize(tilesX * tilesY);
         
-        int nbytes = width*height*bytespp*sizeof(unsigned char);
-        buffer = new unsigned char[nbytes];
-        memset(buffer, 0, nbytes);
+        hiz.init(width, height);
         
-        zbuffer = new float[width*height];
+        visId = new int[width*height];
+        visBc = new float[2*width*height];
         for (int i = 0; i < width*height; i++) {
-            zbuffer[i] = zDefault;
+            visId[i] = -1;
         }
+        
+        pool = new ThreadPool();
+        workers.resize(pool->size());
+        
+        clear();
+    }
+    
+    ~SoftRenderer() {
+        hiz.release();
+        delete [] visId;
+        delete [] visBc;
+        delete [] hizFaces;
+        delete pool;
+    }
+    
+    void setThreads(int n) {
+        delete pool;
+        pool = new ThreadPool(n);
+        workers.resize(pool->size());
+    }
+    
+    int getThreads() {return pool->size();}
+    
+#ifdef ELEANOR_PROFILE
+    //the calling thread's trace, for stages outside the renderer
+    TraceRing &getTrace() {return workers[0].trace;}
+#endif
+    
+    //Chrome trace of the latest stages of every raster thread, needs a
+    //build with ELEANOR_PROFILE
+    bool writeTrace(const std::string &filename) {
+#ifdef ELEANOR_PROFILE
+        std::vector<const TraceRing *> rings;
+        for (size_t i = 0; i < workers.size(); i++) rings.push_back(&workers[i].trace);
+        return writeChromeTrace(filename, rings);
+#else
+        std::cerr << "cannot write " << filename << ": built without ELEANOR_PROFILE" << std::endl;
+        return false;
+#endif
     }
     
     void setTransforms(Transforms *t) {
@@ -59,39 +236,88 @@ public:
         _enableZTest = z;
     }
     
+    void enableTiling(bool t) {
+        _enableTiling = t;
+    }
+    
+    void setCullMode(CullMode c) {
+        cullMode = c;
+    }
+    
+    CullMode getCullMode() {return cullMode;}
+    
+    //16-bit depth halves the bytes per pixel of the 32-bit formats
+    void setDepthFormat(DepthFormat f) {
+        if (f == frame.getDepthFormat()) return;
+        frame.setDepthFormat(f);
+        clear();
+    }
+    
+    DepthFormat getDepthFormat() {return frame.getDepthFormat();}
+    
+    //Takes full effect at the next clear(). The test is for the depth
+    //direction in use: switching reversed-Z on or off mirrors it, so the
+    //default LEQUAL becomes GEQUAL.
+    void setDepthFunc(DepthFunc f) {
+        depthFunc = f;
+    }
+    
+    //Reversed-Z: depth goes from 1 at the near plane to 0 at the far plane, or
+    //at infinity when far is INFINITY, and is cleared to 0. Turning it on or off
+    //mirrors the depth test, less for greater, and leaves it alone otherwise.
+    //With float depth the precision stays even over distance.
+    //near and far must be the ones of the perspective projection in use. The
+    //depth is computed from clip w rather than z, so the projection and the
+    //shaders, which light in clip space, stay as they are.
+    void setReversedZ(bool r, float near = 0.1f, float far = INFINITY) {
+        if (r != reversedZ) depthFunc = mirrorDepthFunc(depthFunc);
+        reversedZ = r;
+        //depth = scale/w + bias
+        reversedScale = std::isinf(far) ? near : far*near/(far - near);
+        reversedBias = std::isinf(far) ? 0.0f : -near/(far - near);
+    }
+    
+    //rasterize face ids first and shade every visible pixel once at the end of model()
+    void enableVisibilityBuffer(bool v) {
+        _enableVisibility = v;
+    }
+    
     bool set(int x, int y, const TGAColor &c) {
-        if (x<0 || x>=width || y<0 || y>=height) return false;
-        
-        memcpy(buffer+(x+y*width)*bytespp, c.bgra, bytespp);
-        return true;
+        return frame.set(x, y, c);
     }
     
-    void draw(SDL_Renderer *sdlRenderer) {
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                TGAColor color(buffer+(x+y*width)*bytespp, bytespp);
-                SDL_SetRenderDrawColor(sdlRenderer, color.bgra[2], color.bgra[1], color.bgra[0], color.bgra[3]);
-                //flip y axis
-                SDL_RenderDrawPoint(sdlRenderer, x, height - y);
-            }
-        }
+    //the finished frame, pending clears resolved
+    FrameBuffer &getFrameBuffer() {
+        frame.resolve();
+        return frame;
     }
     
     int getWidth() {return width;}
     int getHeight() {return height;}
     
+    //counters since the last clear()
+    RenderStats &getStats() {return stats;}
+    
     void clear() {
-        memset(buffer, 0, width*height*sizeof(Uint32));
-        for (int i = 0; i < width*height; i++) {
-            zbuffer[i] = zDefault;
-        }
+        float z = reversedZ ? 0.0f : 1.0f;
+        frame.clear(0, z);
+        hizGreater = depthFunc == DEPTH_GREATER || depthFunc == DEPTH_GEQUAL;
+        hiz.clear(hizKey(frame.depthKey(z)));
+        stats.reset();
+        stats.framePixels = (long)width * height;
     }
     
     void triangle(vector3 *pts, const TGAColor &color);
-    void triangle(vector4 *pts, IShader &shader);
+    //varyings are the processVertex() outputs of the three vertices, the
+    //triangle is shaded immediately even with the visibility buffer enabled
+    template <class Shader>
+    void triangle(vector4 *pts, VertexVaryings *varyings, Shader &shader);
     void line(int x0, int y0, int x1, int y1, const TGAColor &color);
     
-    void model(Model &modelObj, IShader &shader);
+    //Pass an IShader reference to switch shaders at runtime through virtual
+    //calls, or the concrete shader to get a pipeline compiled for it.
+    template <class Shader>
+    void model(Model &modelObj, Shader &shader);
     
     void wireframe(Model &modelObj, const TGAColor &color);
     
@@ -133,7 +359,7 @@ void SoftRenderer::drawLine(vector4 start, vector4 end, TGAColor &color) {
     vector4 s = transforms->projection * transforms->view * start;
     vector4 e = transforms->projection * transforms->view * end;
     
-    if (s.w < EPSILON || e.w < EPSILON) return;
+    if (!clipper.clipLine(s, e)) return;
     
     vector4 ss = mViewport * vector4(s.x/s.w, s.y/s.w, s.z/s.w, 1.0f);
     vector4 ee = mViewport * vector4(e.x/e.w, e.y/e.w, e.z/e.w, 1.0f);
@@ -170,100 +396,705 @@ void SoftRenderer::drawAxes() {
     drawLine(start, end, color);
 }
 
-vector3 SoftRenderer::barycentric(vector3 *pts, vector2 p) {
-    vector3 u;
-    vector3Cross(u, vector3(pts[2].x-pts[0].x, pts[1].x-pts[0].x, pts[0].x-p.x), vector3(pts[2].y-pts[0].y, pts[1].y-pts[0].y, pts[0].y-p.y));
-    if (std::abs(u.z) < 1) return vector3(-1, 1, 1);
-    return vector3(1.0f-(u.x+u.y)/u.z, u.y/u.z, u.x/u.z);
+void SoftRenderer::triangle(vector3 *pts, const TGAColor &color) {
+    float w[3] = {1.0f, 1.0f, 1.0f};
+    TriangleSetup ts;
+    if (ts.setup(pts, w, 0, 0, width-1, height-1) != RASTER_DRAW) return;
+    frame.prepare(ts.minX, ts.minY, ts.maxX, ts.maxY);
+    
+    uint32_t c = FrameBuffer::pack(color);
+    int row[3] = {ts.e[0], ts.e[1], ts.e[2]};
+    float zrow = ts.z0;
+    for (int y = ts.minY; y <= ts.maxY; y++) {
+        int e0 = row[0], e1 = row[1], e2 = row[2];
+        float z = zrow;
+        for (int x = ts.minX; x <= ts.maxX; x++) {
+            int key = frame.depthKey(z);
+            if ((e0 | e1 | e2) >= 0 && depthPass(depthFunc, key, frame.getDepthKey(x, y))) {
+                frame.setDepthKey(x, y, key);
+                frame.setColor(x, y, c);
+            }
+            e0 += ts.dx[0]; e1 += ts.dx[1]; e2 += ts.dx[2];
+            z += ts.dzdx;
+        }
+        row[0] += ts.dy[0]; row[1] += ts.dy[1]; row[2] += ts.dy[2];
+        zrow += ts.dzdy;
+    }
 }
 
-void SoftRenderer::triangle(vector3 *pts, const TGAColor &color) {
-    vector2 bboxmin(width-1, height-1);
-    vector2 bboxmax(0, 0);
-    vector2 clamp(width-1, height-1);
+//Clip a triangle against the near plane and guard band, then drop it if it
+//cannot produce pixels: all vertices outside one clip plane, zero area on
+//screen, or facing away according to cullMode. Returns the number of vertices
+//of the clipped polygon, 0 when the triangle is gone.
+int SoftRenderer::clipAndCull(vector4 *pts, ClipVertex *poly, RenderStats &st) {
+    st.trianglesSubmitted++;
+    
     for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 2; j++) {
-            bboxmin[j] = std::max(0.0f, std::min(bboxmin[j], pts[i][j]));
-            bboxmax[j] = std::min(clamp[j], std::max(bboxmax[j], pts[i][j]));
+        int out = 0;
+        for (int k = 0; k < 3; k++) {
+            if (pts[k][i] < -pts[k].w) out++;
         }
-    }
-    vector2 p;
-    for (p.x=bboxmin.x; p.x <= bboxmax.x; p.x++) {
-        for (p.y=bboxmin.y; p.y <= bboxmax.y; p.y++) {
-            vector3 bc = barycentric(pts, p);
-            if (bc.x<0 || bc.y<0 || bc.z<0) continue;
-            
-            float z = 0;
-            for (int i=0; i<3; i++) z += pts[i][2]*bc[i];
-            if (zbuffer[int(p.x+p.y*width)] >= z) {
-                zbuffer[int(p.x+p.y*width)] = z;
-                set(p.x, p.y, color);
-            }
+        if (out == 3) {
+            st.trianglesCulledFrustum++;
+            return 0;
         }
+        out = 0;
+        for (int k = 0; k < 3; k++) {
+            if (pts[k][i] > pts[k].w) out++;
+        }
+        if (out == 3) {
+            st.trianglesCulledFrustum++;
+            return 0;
+        }
+    }
+    
+    bool clipped;
+    int n = clipper.clip(pts, poly, clipped);
+    if (n == 0) {
+        st.trianglesCulledFrustum++;
+        return 0;
     }
+    if (clipped) st.trianglesClipped++;
+    
+    //every vertex is in front of the near plane now, so the winding is reliable
+    float area = 0.0f;
+    for (int k = 0; k < n; k++) {
+        vector4 &a = poly[k].pos;
+        vector4 &b = poly[(k+1)%n].pos;
+        area += (a.x/a.w)*(b.y/b.w) - (b.x/b.w)*(a.y/a.w);
+    }
+    area *= width*height*0.25f;
+    
+    //smaller than one cell of the subpixel grid
+    if (std::abs(area) < 1.0f/(SUBPIXEL_ONE*SUBPIXEL_ONE)) {
+        st.trianglesCulledDegenerate++;
+        return 0;
+    }
+    if ((cullMode == CULL_BACK && area < 0) || (cullMode == CULL_FRONT && area > 0)) {
+        st.trianglesCulledFacing++;
+        return 0;
+    }
+    
+    st.trianglesRasterized++;
+    return n;
 }
 
-void SoftRenderer::triangle(vector4 *in_pts, IShader &shader) {
-    vector3 pts[3];
+//rasterize a clipped polygon as a fan
+template <class Shader>
+void SoftRenderer::drawPolygon(ClipVertex *poly, int n, const float **varyings, Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1) {
+    bool clipped = Clipper::isClipped(poly, n);
+    for (int i = 1; i + 1 < n; i++) {
+        vector4 pts[3] = {poly[0].pos, poly[i].pos, poly[i+1].pos};
+        vector3 bcMap[3] = {poly[0].bc, poly[i].bc, poly[i+1].bc};
+        triangle(pts, varyings, shader, worker, x0, y0, x1, y1, clipped ? bcMap : NULL);
+    }
+}
+
+void SoftRenderer::toScreen(vector4 *in_pts, vector3 *pts) {
     for (int i = 0; i < 3; i++) {
         vector4 v = in_pts[i];
         v = mViewport * vector4(v.x/v.w, v.y/v.w, v.z/v.w, 1.0f);
-        pts[i] = vector3(v.x, v.y, v.z);
+        pts[i] = vector3(v.x, v.y, reversedZ ? reversedScale/in_pts[i].w + reversedBias : v.z);
     }
+}
+
+template <class Shader>
+void SoftRenderer::triangle(vector4 *in_pts, VertexVaryings *varyings, Shader &shader) {
+    bool clipped;
+    ClipVertex poly[MAX_CLIP_VERTS];
+    int n = clipper.clip(in_pts, poly, clipped);
+    const float *face[3] = {varyings[0], varyings[1], varyings[2]};
+    workers[0].face = -1;
+    drawPolygon(poly, n, face, shader, workers[0], 0, 0, width-1, height-1);
+    stats.add(workers[0].stats);
+    workers[0].stats.reset();
+}
+
+//rasterize only the pixels inside the inclusive rect [x0,x1]x[y0,y1]
+template <class Shader>
+void SoftRenderer::triangle(vector4 *in_pts, const float **varyings, Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1, const vector3 *bcMap) {
+    PROFILE_TIME(worker.stats.triangleNs);
+    vector3 pts[3];
+    toScreen(in_pts, pts);
     
-    vector2 bboxmin(width-1, height-1);
-    vector2 bboxmax(0, 0);
-    vector2 clamp(width-1, height-1);
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 2; j++) {
-            bboxmin[j] = std::max(0.0f, std::min(bboxmin[j], pts[i][j]));
-            bboxmax[j] = std::min(clamp[j], std::max(bboxmax[j], pts[i][j]));
+    float w[3] = {in_pts[0].w, in_pts[1].w, in_pts[2].w};
+    TriangleSetup ts;
+    if (ts.setup(pts, w, x0, y0, x1, y1) == RASTER_SKIP) return;
+    if (bcMap) ts.mapToSource(bcMap);
+    
+    //nearest depth of the triangle against the coarse depth of its blocks
+    int zmin = INT_MIN;
+    if (hizActive()) {
+        float znear = hizGreater ? std::max(pts[0].z, std::max(pts[1].z, pts[2].z))
+                                 : std::min(pts[0].z, std::min(pts[1].z, pts[2].z));
+        zmin = hizKey(frame.depthKey(znear));
+        int total;
+        int occluded = hiz.occludedBlocks(ts.minX, ts.minY, ts.maxX, ts.maxY, zmin, total);
+        worker.stats.hizBlocksRejected += occluded;
+        if (occluded == total) {
+            markHizFace(worker, HIZ_REJECTED);
+            return;
         }
+        markHizFace(worker, HIZ_PASSED);
     }
+    frame.prepare(ts.minX, ts.minY, ts.maxX, ts.maxY);
+    
+    //the visibility buffer only needs the barycentrics
+    TriangleVaryings tv;
+    if (!deferShading(worker)) tv.setup(ts, varyings, shader.varyingCount());
+    
+    {
+        PROFILE_TIME(worker.stats.rasterNs);
+#ifdef SIMD_WIDTH
+        rasterizeBlocks(ts, tv, shader, worker, zmin);
+#else
+        rasterizeScalar(ts, tv, shader, worker, zmin);
+#endif
+    }
+    hiz.update(frame, hizGreater, worker.hizDirty);
+}
 
-    vector2 p;
-    int x, y;
-    for (x = bboxmin.x; x <= bboxmax.x; x++) {
-        for (y = bboxmin.y; y <= bboxmax.y; y++) {
-            p.x = x;
-            p.y = y;
-            vector3 bc = barycentric(pts, p);
+template <class Shader>
+void SoftRenderer::rasterizeScalar(TriangleSetup &ts, TriangleVaryings &tv, Shader &shader, RasterWorker &worker, int zmin) {
+    float varyings[MAX_VARYINGS*4];
+    TGAColor colors[4];
+    int row[3] = {ts.e[0], ts.e[1], ts.e[2]};
+    float zrow = ts.z0;
+    for (int y = ts.minY; y <= ts.maxY; y++) {
+        int e[3] = {row[0], row[1], row[2]};
+        float z = zrow;
+        for (int x = ts.minX; x <= ts.maxX; x++) {
+            int key = frame.depthKey(z);
+            bool inside = (e[0] | e[1] | e[2]) >= 0 && !hiz.occluded(x, y, zmin);
+            PROFILE_COUNT(worker.stats.pixelsTested += inside);
+            if (inside && (!_enableZTest || depthPass(depthFunc, key, frame.getDepthKey(x, y)))) {
+                PROFILE_COUNT(worker.stats.pixelsPassed++);
+                frame.setDepthKey(x, y, key);
+                hiz.touch(x, y, worker.hizDirty);
+                float bw[3];
+                ts.weights(e, bw);
+                if (deferShading(worker)) {
+                    vector3 bc;
+                    ts.toSource(bw, bc);
+                    setVisibility(x, y, worker.face, bc);
+                } else {
+                    //shade the pixel as the first lane of a quad, the others
+                    //only supply the derivatives
+                    for (int i = 0; i < 4; i++) {
+                        int qe[3];
+                        for (int k = 0; k < 3; k++) qe[k] = e[k] + (i & 1)*ts.dx[k] + (i >> 1)*ts.dy[k];
+                        ts.weights(qe, bw);
+                        tv.interpolate(bw, varyings + i, 4);
+                    }
+                    {
+                        PROFILE_TIME(worker.stats.shadeNs);
+                        shader.shadeBlock(varyings, 4, 4, 1, true, colors);
+                    }
+                    frame.setColor(x, y, FrameBuffer::pack(colors[0]));
+                    worker.stats.fragmentsShaded++;
+                }
+            }
+            e[0] += ts.dx[0]; e[1] += ts.dx[1]; e[2] += ts.dx[2];
+            z += ts.dzdx;
+        }
+        row[0] += ts.dy[0]; row[1] += ts.dy[1]; row[2] += ts.dy[2];
+        zrow += ts.dzdy;
+    }
+}
 
-            if (bc.x<0 || bc.y<0 || bc.z<0) continue;
+#ifdef SIMD_WIDTH
+//Walk the bounding box in aligned BLOCK_W x BLOCK_H blocks, evaluating the
+//edges, depth and depth test of all lanes together. Only lanes inside the
+//bounding box touch memory, so tiles still never write outside their rect.
+//A raster block always lies inside a single hi-z block.
+template <class Shader>
+void SoftRenderer::rasterizeBlocks(TriangleSetup &ts, TriangleVaryings &tv, Shader &shader, RasterWorker &worker, int zmin) {
+    SIMD_ALIGN int laneE[3][BLOCK_SIZE];
+    SIMD_ALIGN float laneZ[BLOCK_SIZE];
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        for (int k = 0; k < 3; k++) {
+            laneE[k][i] = ts.dx[k]*blockLaneX(i) + ts.dy[k]*blockLaneY(i);
+        }
+        laneZ[i] = ts.dzdx*blockLaneX(i) + ts.dzdy*blockLaneY(i);
+    }
+    vint offE0 = simdLoadInt(laneE[0]);
+    vint offE1 = simdLoadInt(laneE[1]);
+    vint offE2 = simdLoadInt(laneE[2]);
+    vfloat offZ = simdLoad(laneZ);
+    vint stepE0 = simdSet1Int(ts.dx[0]*BLOCK_W);
+    vint stepE1 = simdSet1Int(ts.dx[1]*BLOCK_W);
+    vint stepE2 = simdSet1Int(ts.dx[2]*BLOCK_W);
+    vfloat stepZ = simdSet1(ts.dzdx*BLOCK_W);
+    vfloat invW0 = simdSet1(ts.invW[0]);
+    vfloat invW1 = simdSet1(ts.invW[1]);
+    vfloat invW2 = simdSet1(ts.invW[2]);
+    vfloat one = simdSet1(1.0f);
+    
+    int bx0 = ts.minX & ~(BLOCK_W-1);
+    int by0 = ts.minY & ~(BLOCK_H-1);
+    
+    SIMD_ALIGN int zb[BLOCK_SIZE];
+    SIMD_ALIGN int zs[BLOCK_SIZE];
+    SIMD_ALIGN float b0[BLOCK_SIZE];
+    SIMD_ALIGN float b1[BLOCK_SIZE];
+    SIMD_ALIGN float b2[BLOCK_SIZE];
+    SIMD_ALIGN float varyings[MAX_VARYINGS*BLOCK_SIZE];
+    TGAColor colors[BLOCK_SIZE];
+    
+    for (int by = by0; by <= ts.maxY; by += BLOCK_H) {
+        int ox = bx0 - ts.minX;
+        int oy = by - ts.minY;
+        vint e0 = simdAddInt(simdSet1Int(ts.e[0] + ox*ts.dx[0] + oy*ts.dy[0]), offE0);
+        vint e1 = simdAddInt(simdSet1Int(ts.e[1] + ox*ts.dx[1] + oy*ts.dy[1]), offE1);
+        vint e2 = simdAddInt(simdSet1Int(ts.e[2] + ox*ts.dx[2] + oy*ts.dy[2]), offE2);
+        vfloat z = simdAdd(simdSet1(ts.z0 + ox*ts.dzdx + oy*ts.dzdy), offZ);
+        
+        for (int bx = bx0; bx <= ts.maxX; bx += BLOCK_W) {
+            unsigned int mask = simdMaskNonNegative(simdOrInt(simdOrInt(e0, e1), e2));
+            if (mask && hiz.occluded(bx, by, zmin)) mask = 0;
             
-            vector3 bc_clip = vector3(bc.x/in_pts[0].w, bc.y/in_pts[1].w, bc.z/in_pts[2].w);
-            bc = bc_clip / (bc_clip.x + bc_clip.y + bc_clip.z);
-
-            float z = 0;
-            for (int i=0; i<3; i++) {
-                z += pts[i].z*bc[i];
+            vint keys;
+            if (mask) {
+                //drop lanes outside the bounding box and gather their depth
+                for (int i = 0; i < BLOCK_SIZE; i++) {
+                    int x = bx + blockLaneX(i);
+                    int y = by + blockLaneY(i);
+                    if (x < ts.minX || x > ts.maxX || y < ts.minY || y > ts.maxY) {
+                        mask &= ~(1u << i);
+                        zb[i] = 0;
+                    } else {
+                        zb[i] = frame.getDepthKey(x, y);
+                    }
+                }
+                keys = frame.depthKeys(z);
+                PROFILE_COUNT(worker.stats.pixelsTested += __builtin_popcount(mask));
+                if (_enableZTest) mask &= depthPassMask(depthFunc, keys, simdLoadInt(zb));
+                PROFILE_COUNT(worker.stats.pixelsPassed += __builtin_popcount(mask));
             }
             
-            bool retain = false;
-            if (!_enableZTest || (_enableZTest && zbuffer[int(p.x+p.y*width)] >= z)) retain = true;
-
-            if (retain) {
-                zbuffer[int(p.x+p.y*width)] = z;
-                TGAColor color;
-                shader.fragment(bc, color);
-                set(p.x, p.y, color);
+            if (mask) {
+                hiz.touch(bx, by, worker.hizDirty);
+                simdStoreInt(zs, keys);
+                
+                vfloat f0 = simdMul(simdToFloat(e0), invW0);
+                vfloat f1 = simdMul(simdToFloat(e1), invW1);
+                vfloat f2 = simdMul(simdToFloat(e2), invW2);
+                vfloat r = simdDiv(one, simdAdd(simdAdd(f0, f1), f2));
+                vfloat w0 = simdMul(f0, r);
+                vfloat w1 = simdMul(f1, r);
+                vfloat w2 = simdMul(f2, r);
+                
+                for (int i = 0; i < BLOCK_SIZE; i++) {
+                    if (mask & (1u << i)) frame.setDepthKey(bx + blockLaneX(i), by + blockLaneY(i), zs[i]);
+                }
+                
+                if (deferShading(worker)) {
+                    simdStore(b0, w0);
+                    simdStore(b1, w1);
+                    simdStore(b2, w2);
+                    for (int i = 0; i < BLOCK_SIZE; i++) {
+                        if (!(mask & (1u << i))) continue;
+                        float bw[3] = {b0[i], b1[i], b2[i]};
+                        vector3 bc;
+                        ts.toSource(bw, bc);
+                        setVisibility(bx + blockLaneX(i), by + blockLaneY(i), worker.face, bc);
+                    }
+                } else {
+                    //perspective-correct varyings of all lanes, one component per vector
+                    for (int k = 0; k < tv.count; k++) {
+                        vfloat v = simdMul(w0, simdSet1(tv.v[0][k]));
+                        v = simdAdd(v, simdMul(w1, simdSet1(tv.v[1][k])));
+                        v = simdAdd(v, simdMul(w2, simdSet1(tv.v[2][k])));
+                        simdStore(varyings + k*BLOCK_SIZE, v);
+                    }
+                    {
+                        PROFILE_TIME(worker.stats.shadeNs);
+                        shader.shadeBlock(varyings, BLOCK_SIZE, BLOCK_SIZE, mask, true, colors);
+                    }
+                    
+                    for (int i = 0; i < BLOCK_SIZE; i++) {
+                        if (mask & (1u << i)) frame.setColor(bx + blockLaneX(i), by + blockLaneY(i), FrameBuffer::pack(colors[i]));
+                    }
+                    worker.stats.fragmentsShaded += __builtin_popcount(mask);
+                }
             }
+            
+            e0 = simdAddInt(e0, stepE0);
+            e1 = simdAddInt(e1, stepE1);
+            e2 = simdAddInt(e2, stepE2);
+            z = simdAdd(z, stepZ);
         }
     }
 }
+#endif
 
-void SoftRenderer::model(Model &modelObj, IShader &shader) {
+template <class Shader>
+void SoftRenderer::model(Model &modelObj, Shader &shader) {
+    PROFILE_TRACE(workers[0].trace, "model");
     
     shader.init();
+    processVertices(modelObj, shader);
+    int faceCount = modelObj.getIndexSize()/3;
+    resetHizFaces(faceCount);
+    
+    if (_enableTiling && pool->size() > 1) {
+        modelTiled(modelObj, shader);
+        countHizFaces(faceCount);
+        return;
+    }
+    
+    //the visibility pass samples no textures, all faces are rasterized
+    //before the first batch is resolved
+    for (int b = 0; b < modelObj.getBatchCount();) {
+        int first, last;
+        int end = bindBatches(modelObj, b, first, last);
+        if (!_enableVisibility || b == 0) {
+            PROFILE_TRACE(workers[0].trace, "raster");
+            int rasterFirst = _enableVisibility ? 0 : first;
+            int rasterLast = _enableVisibility ? faceCount : last;
+            for (int f = rasterFirst; f < rasterLast; f++) {
+                
+                vector4 pts[3];
+                const float *varyings[3];
+                fetchFace(f, pts, varyings);
+                
+                ClipVertex poly[MAX_CLIP_VERTS];
+                int n = clipAndCull(pts, poly, stats);
+                if (n == 0) continue;
+                
+                workers[0].face = f;
+                drawPolygon(poly, n, varyings, shader, workers[0], 0, 0, width-1, height-1);
+            }
+        }
+        
+        if (_enableVisibility) {
+            PROFILE_TRACE(workers[0].trace, "resolve visibility");
+            resolveVisibility(shader, workers[0], 0, 0, width-1, height-1, first, last);
+        }
+        b = end;
+    }
+    
+    stats.add(workers[0].stats);
+    workers[0].stats.reset();
+    countHizFaces(faceCount);
+}
+
+void SoftRenderer::resetHizFaces(int faceCount) {
+    if (!hizActive()) return;
+    if (faceCount > hizFaceCapacity) {
+        delete [] hizFaces;
+        hizFaces = new std::atomic<unsigned char>[faceCount];
+        hizFaceCapacity = faceCount;
+    }
+    for (int f = 0; f < faceCount; f++) hizFaces[f].store(0, std::memory_order_relaxed);
+}
+
+void SoftRenderer::countHizFaces(int faceCount) {
+    if (!hizActive()) return;
+    for (int f = 0; f < faceCount; f++) {
+        if (hizFaces[f].load(std::memory_order_relaxed) == HIZ_REJECTED) stats.hizTrianglesRejected++;
+    }
+}
+
+//Run the vertex shader once per vertex into the post-transform buffer. Shaders
+//whose outputs depend only on the vertex's index triple share vertices between
+//faces, the others get one per face corner.
+template <class Shader>
+void SoftRenderer::processVertices(Model &modelObj, Shader &shader) {
+    cornerVertices = shader.sharedVertices() ? modelObj.getIndices() : NULL;
+    int count = cornerVertices ? modelObj.getVertexCount() : modelObj.getIndexSize();
+    vertexStride = shader.varyingCount();
+    vertexPositions.resize(count);
+    vertexVaryings.resize(count * vertexStride);
+    
+    //the shader only reads uniforms, so chunks can run on any worker
+    const int CHUNK = 256;
+    auto job = [&](int chunk, int worker) {
+        (void)worker;   //only the profiling macros use it
+        PROFILE_TRACE(workers[worker].trace, "vertices");
+        PROFILE_TIME(workers[worker].stats.vertexNs);
+        int start = chunk*CHUNK;
+        int end = std::min(count, start + CHUNK);
+        int corners[CHUNK];
+        for (int i = start; i < end; i++) {
+            corners[i - start] = cornerVertices ? modelObj.getVertexCorner(i) : i;
+        }
+        shader.processVertices(corners, end - start, &vertexPositions[start], vertexVaryings.data() + start*vertexStride);
+    };
+    int chunks = (count + CHUNK - 1) / CHUNK;
+    if (_enableTiling) {
+        pool->parallelFor(chunks, job);
+    } else {
+        for (int i = 0; i < chunks; i++) job(i, 0);
+    }
+    
+    stats.verticesShaded += count;
+}
+
+void SoftRenderer::fetchFace(int face, vector4 *pts, const float **varyings) {
+    for (int k = 0; k < 3; k++) {
+        int v = cornerVertices ? cornerVertices[3*face + k] : 3*face + k;
+        pts[k] = vertexPositions[v];
+        varyings[k] = &vertexVaryings[v*vertexStride];
+    }
+}
+
+//Sort the faces into the bins of the screen tiles their bounding box touches.
+//Clipped polygons are kept for the tiles, the other faces are fetched again.
+void SoftRenderer::binFaces(Model &modelObj) {
+    PROFILE_TRACE(workers[0].trace, "bin");
+    for (size_t i = 0; i < bins.size(); i++) bins[i].clear();
+    binPolygons.clear();
     
     for (int f = 0; f < modelObj.getIndexSize()/3; f++) {
         
-        vector4 pts[3];
-        for (int k = 0; k < 3; k++) {
-            pts[k] = shader.vertex(f, k);
+        vector4 in_pts[3];
+        const float *varyings[3];
+        fetchFace(f, in_pts, varyings);
+        
+        ClipVertex poly[MAX_CLIP_VERTS];
+        int n = clipAndCull(in_pts, poly, stats);
+        if (n == 0) continue;
+        
+        float xmin = width, ymin = height, xmax = -1, ymax = -1;
+        for (int k = 0; k < n; k++) {
+            vector4 &v = poly[k].pos;
+            vector4 p = mViewport * vector4(v.x/v.w, v.y/v.w, v.z/v.w, 1.0f);
+            xmin = std::min(xmin, p.x);
+            xmax = std::max(xmax, p.x);
+            ymin = std::min(ymin, p.y);
+            ymax = std::max(ymax, p.y);
+        }
+        if (xmax < 0 || ymax < 0 || xmin > width-1 || ymin > height-1) continue;
+        
+        BinEntry entry = {f, -1, n};
+        if (Clipper::isClipped(poly, n)) {
+            entry.polygon = (int)binPolygons.size();
+            binPolygons.insert(binPolygons.end(), poly, poly + n);
+        }
+        
+        //widen by a pixel, the fixed-point bounds can round past the float ones
+        int tx0 = std::max(0, (int)xmin - 1) / TILE_SIZE;
+        int tx1 = std::min(width-1, (int)xmax + 1) / TILE_SIZE;
+        int ty0 = std::max(0, (int)ymin - 1) / TILE_SIZE;
+        int ty1 = std::min(height-1, (int)ymax + 1) / TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                bins[tx + ty*tilesX].push_back(entry);
+            }
         }
+    }
+}
+
+//Bind the textures of a batch, and return the end of the run of batches that
+//share them. The run's faces, [firstFace, lastFace), are drawn together.
+int SoftRenderer::bindBatches(Model &modelObj, int batch, int &firstFace, int &lastFace) {
+    const MaterialTextures *textures = modelObj.getBatch(batch).textures;
+    int end = batch + 1;
+    while (end < modelObj.getBatchCount() && modelObj.getBatch(end).textures == textures) end++;
+    modelObj.bindTextures(textures);
+    firstFace = modelObj.getBatch(batch).firstFace;
+    lastFace = modelObj.getBatch(end - 1).firstFace + modelObj.getBatch(end - 1).faceCount;
+    stats.batchesDrawn += end - batch;
+    stats.textureBinds++;
+    return end;
+}
+
+//Bin every face into the screen tiles its bounding box touches, then let the
+//workers rasterize whole tiles. A tile is only ever written by one worker, so
+//the frame needs no locking. Faces are read back from the
+//post-transform buffer.
+//Runs of batches with the same textures are drawn one after the other, each
+//picking up in the bins where the last one stopped, since batches are ranges
+//of faces and bins hold faces in order.
+template <class Shader>
+void SoftRenderer::modelTiled(Model &modelObj, Shader &shader) {
+    
+    binFaces(modelObj);
+    std::vector<size_t> binStart(bins.size(), 0);
+    int faceCount = modelObj.getIndexSize()/3;
+    
+    for (int b = 0; b < modelObj.getBatchCount();) {
+        int first, last;
+        int end = bindBatches(modelObj, b, first, last);
+        //the visibility pass samples no textures, all faces are rasterized
+        //before the first batch is resolved
+        bool raster = !_enableVisibility || b == 0;
+        int rasterLast = _enableVisibility ? faceCount : last;
         
-        triangle(pts, shader);
+        pool->parallelFor(tilesX * tilesY, [&](int tile, int worker) {
+            RasterWorker &w = workers[worker];
+            PROFILE_TRACE(w.trace, "tile");
+            std::vector<BinEntry> &bin = bins[tile];
+            
+            int x0 = (tile % tilesX) * TILE_SIZE;
+            int y0 = (tile / tilesX) * TILE_SIZE;
+            int x1 = std::min(x0 + TILE_SIZE, width) - 1;
+            int y1 = std::min(y0 + TILE_SIZE, height) - 1;
+            
+            size_t i = binStart[tile];
+            for (; raster && i < bin.size() && bin[i].face < rasterLast; i++) {
+                const BinEntry &entry = bin[i];
+                vector4 pts[3];
+                const float *varyings[3];
+                fetchFace(entry.face, pts, varyings);
+                ClipVertex unclipped[3];
+                ClipVertex *poly = unclipped;
+                if (entry.polygon >= 0) poly = &binPolygons[entry.polygon];
+                else Clipper::unclipped(pts, unclipped);
+                
+                w.face = entry.face;
+                drawPolygon(poly, entry.count, varyings, shader, w, x0, y0, x1, y1);
+            }
+            binStart[tile] = i;
+            
+            if (_enableVisibility) resolveVisibility(shader, w, x0, y0, x1, y1, first, last);
+        });
+        b = end;
+    }
+    
+    for (size_t i = 0; i < workers.size(); i++) {
+        stats.add(workers[i].stats);
+        workers[i].stats.reset();
+    }
+}
+
+//Second pass of the visibility buffer mode: shade every pixel of the rect that
+//got a face in this model() call exactly once. Runs of pixels of the same face
+//are shaded as one block. Only faces in [firstFace, lastFace), the batches
+//whose textures are bound, are shaded, the others are left for their own call.
+//Each pixel is the first lane of a quad whose other lanes only carry the
+//derivatives the forward pass would have given it, so textures pick the same
+//mip level in both modes.
+template <class Shader>
+void SoftRenderer::resolveVisibility(Shader &shader, RasterWorker &worker, int x0, int y0, int x1, int y1, int firstFace, int lastFace) {
+    const int BATCH = 8;
+    const int LANES = 4*BATCH;
+    float varyings[MAX_VARYINGS*LANES];
+    vector4 pts[3];
+    const float *faceVaryings[3];
+    TGAColor colors[LANES];
+    int face = -1;
+    
+    //Barycentrics of the current face at pixel (x,y). A face in front of the
+    //camera gets the rasterizer's fixed-point edges, rounding included, which
+    //matters for faces of a pixel or less. The planes are for faces that were
+    //only drawn clipped.
+    TriangleSetup ts;
+    bool edges = false;
+    float ax[3], ay[3], a0[3];
+    auto weights = [&](int x, int y, float *b) {
+        if (edges) {
+            int e[3];
+            for (int k = 0; k < 3; k++) e[k] = ts.e[k] + (x - ts.minX)*ts.dx[k] + (y - ts.minY)*ts.dy[k];
+            float w[3];
+            ts.weights(e, w);
+            vector3 bc;
+            ts.toSource(w, bc);
+            for (int k = 0; k < 3; k++) b[k] = bc[k];
+            return;
+        }
+        float a[3];
+        for (int k = 0; k < 3; k++) a[k] = ax[k]*x + ay[k]*y + a0[k];
+        float r = 1.0f / (a[0] + a[1] + a[2]);
+        for (int k = 0; k < 3; k++) b[k] = a[k]*r;
+    };
+    
+    //varying differences across the last quad, shared by its pixels
+    float dvx[MAX_VARYINGS], dvy[MAX_VARYINGS];
+    int quadX = -1, quadY = -1;
+    
+    for (int y = y0; y <= y1; y++) {
+        int x = x0;
+        while (x <= x1) {
+            int f = visId[x + y*width];
+            if (f < firstFace || f >= lastFace) {
+                x++;
+                continue;
+            }
+            if (f != face) {
+                fetchFace(f, pts, faceVaryings);
+                edges = false;
+                if (pts[0].w > 0 && pts[1].w > 0 && pts[2].w > 0) {
+                    vector3 screen[3];
+                    toScreen(pts, screen);
+                    float w[3] = {pts[0].w, pts[1].w, pts[2].w};
+                    edges = ts.setup(screen, w, 0, 0, width-1, height-1) == RASTER_DRAW;
+                }
+                if (!edges) weightPlanes(pts, ax, ay, a0);
+                face = f;
+                quadX = -1;
+            }
+            
+            int start = x;
+            int count = 0;
+            unsigned int mask = 0;
+            while (x <= x1 && count < BATCH && visId[x + y*width] == face) {
+                int i = x + y*width;
+                float bc[3] = {visBc[2*i], visBc[2*i+1], 1.0f - visBc[2*i] - visBc[2*i+1]};
+                
+                //differences across the pixel's quad, aligned like the blocks
+                //of the forward pass
+#ifdef SIMD_WIDTH
+                int qx = x & ~1, qy = y & ~1;
+#else
+                int qx = x, qy = y;
+#endif
+                if (qx != quadX || qy != quadY) {
+                    float b[3], bx[3], by[3];
+                    weights(qx, qy, b);
+                    weights(qx + 1, qy, bx);
+                    weights(qx, qy + 1, by);
+                    for (int k = 0; k < vertexStride; k++) {
+                        dvx[k] = faceVaryings[0][k]*(bx[0] - b[0]) + faceVaryings[1][k]*(bx[1] - b[1]) + faceVaryings[2][k]*(bx[2] - b[2]);
+                        dvy[k] = faceVaryings[0][k]*(by[0] - b[0]) + faceVaryings[1][k]*(by[1] - b[1]) + faceVaryings[2][k]*(by[2] - b[2]);
+                    }
+                    quadX = qx;
+                    quadY = qy;
+                }
+                
+                int lane = 4*count;
+                for (int k = 0; k < vertexStride; k++) {
+                    float v = faceVaryings[0][k]*bc[0] + faceVaryings[1][k]*bc[1] + faceVaryings[2][k]*bc[2];
+                    float *out = varyings + k*LANES + lane;
+                    out[0] = v;
+                    out[1] = v + dvx[k];
+                    out[2] = v + dvy[k];
+                    out[3] = v;
+                }
+                mask |= 1u << lane;
+                visId[i] = -1;
+                count++;
+                x++;
+            }
+            
+            {
+                PROFILE_TIME(worker.stats.resolveNs);
+                shader.shadeBlock(varyings, LANES, 4*count, mask, true, colors);
+            }
+            for (int i = 0; i < count; i++) {
+                frame.setColor(start + i, y, FrameBuffer::pack(colors[4*i]));
+            }
+            worker.stats.fragmentsShaded += count;
+        }
+    }
+}
+
+//Planes of the perspective-correct barycentrics of a face, in pixels: they are
+//a[k]/(a[0]+a[1]+a[2]) with a[k] = ax[k]*x + ay[k]*y + a0[k]. They come from
+//the clip-space vertices without dividing by w, so they also hold for a face
+//that crosses the near plane.
+void SoftRenderer::weightPlanes(const vector4 *pts, float *ax, float *ay, float *a0) {
+    for (int k = 0; k < 3; k++) {
+        const vector4 &p = pts[(k+1)%3];
+        const vector4 &q = pts[(k+2)%3];
+        //(p x q) . (ndc x, ndc y, 1)
+        float cx = p.y*q.w - p.w*q.y;
+        float cy = p.w*q.x - p.x*q.w;
+        float cw = p.x*q.y - p.y*q.x;
+        ax[k] = cx*2.0f/width;
+        ay[k] = cy*2.0f/height;
+        a0[k] = cw - cx - cy;
     }
 }
 
@@ -272,8 +1103,8 @@ void SoftRenderer::wireframe(Model &modelObj, const TGAColor &color) {
         
         vector3 v[3];
         for (int k = 0; k < 3; k++) {
-            tinyobj::index_t idx = modelObj.getIndex(f, k);
-            v[k] = modelObj.getVertex(idx.vertex_index);
+            int vid = modelObj.getIndex(f, k);
+            v[k] = modelObj.getVertex(vid);
         }
         
         for (int k = 0; k < 3; k++) {
@@ -290,4 +1121,4 @@ void SoftRenderer::wireframe(Model &modelObj, const TGAColor &color) {
     }
 }
 
-#endif /* framebuffer_h */
+#endif /* softrenderer_h */
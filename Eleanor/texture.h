@@ -0,0 +1,252 @@
+//
+//  texture.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef texture_h
+#define texture_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "TGAImage.h"
+#include "math/math.h"
+
+enum TextureFilter {
+    FILTER_NEAREST,     //nearest texel of the full resolution level
+    FILTER_BILINEAR,    //bilinear in the mip level nearest to the footprint
+    FILTER_TRILINEAR    //bilinear in the two levels around it, blended
+};
+
+//Texel formats. Each one converts an image pixel once at load time, and
+//knows how to blend and box filter its texels for the mip chain.
+
+//4 bytes in TGAColor order, channels missing from the image are 0 like
+//TGAImage::get
+struct ColorTexel {
+    typedef uint32_t Type;
+
+    static Type convert(const unsigned char *p, int bytespp) {
+        unsigned char c[4] = {0, 0, 0, 0};
+        memcpy(c, p, std::min(bytespp, 4));
+        Type t;
+        memcpy(&t, c, sizeof(t));
+        return t;
+    }
+
+    //all four 8-bit channels at once, t is the weight of b
+    static Type lerp(Type a, Type b, float t) {
+        uint32_t w = (uint32_t)(t * 256.0f);
+        uint32_t rb = (a & 0xff00ff)*(256 - w) + (b & 0xff00ff)*w + 0x800080;
+        uint32_t ag = ((a >> 8) & 0xff00ff)*(256 - w) + ((b >> 8) & 0xff00ff)*w + 0x800080;
+        return ((rb >> 8) & 0xff00ff) | (ag & 0xff00ff00);
+    }
+
+    static Type average(Type a, Type b, Type c, Type d) {
+        Type res = 0;
+        for (int k = 0; k < 32; k += 8) {
+            uint32_t sum = ((a >> k) & 0xff) + ((b >> k) & 0xff) + ((c >> k) & 0xff) + ((d >> k) & 0xff);
+            res |= ((sum + 2) / 4) << k;
+        }
+        return res;
+    }
+};
+
+//first channel only, for the gray specular maps
+struct ScalarTexel {
+    typedef unsigned char Type;
+
+    static Type convert(const unsigned char *p, int /*bytespp*/) {
+        return p[0];
+    }
+
+    static Type lerp(Type a, Type b, float t) {
+        uint32_t w = (uint32_t)(t * 256.0f);
+        return (Type)((a*(256 - w) + b*w + 128) >> 8);
+    }
+
+    static Type average(Type a, Type b, Type c, Type d) {
+        return (Type)((a + b + c + d + 2) / 4);
+    }
+};
+
+//tangent-space normal map, decoded from BGR and normalized. Blended texels
+//are not unit length anymore, the filtering sampler renormalizes them.
+struct NormalTexel {
+    typedef vector3 Type;
+
+    static Type convert(const unsigned char *p, int bytespp) {
+        unsigned char c[4] = {0, 0, 0, 0};
+        memcpy(c, p, std::min(bytespp, 4));
+        vector3 n;
+        n.x = (float)c[2]/255.0f*2.0f-1.0f;
+        n.y = (float)c[1]/255.0f*2.0f-1.0f;
+        n.z = (float)c[0]/255.0f*2.0f-1.0f;
+        return n.normalize();
+    }
+
+    static Type lerp(const Type &a, const Type &b, float t) {
+        return vector3(a.x + (b.x - a.x)*t, a.y + (b.y - a.y)*t, a.z + (b.z - a.z)*t);
+    }
+
+    static Type average(const Type &a, const Type &b, const Type &c, const Type &d) {
+        vector3 n(a.x + b.x + c.x + d.x, a.y + b.y + c.y + d.y, a.z + b.z + c.z + d.z);
+        return n.length() > 0.0f ? n.normalize() : n;
+    }
+};
+
+//An image and its mip chain, built once at load time. Each level halves the
+//previous one down to 1x1 with a box filter.
+//Levels are stored in 4x4 tiles of 16 consecutive texels, so the texels of a
+//2x2 footprint, or of a span that runs vertically in the image, share cache
+//lines instead of sitting a row apart. Past the last tile every level holds a
+//border texel, the format's conversion of a black pixel: nearest sampling
+//reads it outside [0,1] as the raw image reads black, selecting its index
+//rather than branching. Filtering clamps to the edge.
+template <class Format>
+class Texture {
+public:
+    typedef typename Format::Type Texel;
+
+    //converts the image's texels, img can be released afterwards
+    void build(const TGAImage &img);
+
+    bool empty() const {return levels.empty();}
+    int getWidth() const {return levels.empty() ? 0 : levels[0].width;}
+    int getHeight() const {return levels.empty() ? 0 : levels[0].height;}
+    int getLevels() const {return (int)levels.size();}
+
+    //dx and dy are the screen-space derivatives of the texture coordinates,
+    //they choose the mip level; zero derivatives sample the full resolution
+    Texel sample(float u, float v, const vector2 &dx, const vector2 &dy, TextureFilter filter) const;
+
+    //full resolution, nearest texel
+    Texel sample(float u, float v) const;
+
+    //what sample() returns outside the image or when there is none
+    Texel getBorder() const {return border;}
+
+private:
+    struct Level {
+        int width, height;
+        int tilesPerRow;
+        std::vector<Texel> texels;  //tiles, then the border texel
+
+        size_t index(int x, int y) const {
+            return ((size_t)((y >> 2)*tilesPerRow + (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3);
+        }
+
+        const Texel &at(int x, int y) const {return texels[index(x, y)];}
+    };
+    std::vector<Level> levels;
+    Texel border = Format::convert((const unsigned char *)"\0\0\0\0", 4);
+
+    Level makeLevel(int width, int height) const;
+
+    //level of detail of a footprint, 0 at one texel per pixel or less
+    float lod(const vector2 &dx, const vector2 &dy) const;
+
+    Texel bilinear(int level, float u, float v) const;
+};
+
+template <class Format>
+typename Texture<Format>::Level Texture<Format>::makeLevel(int width, int height) const {
+    Level l;
+    l.width = width;
+    l.height = height;
+    l.tilesPerRow = (width + 3) / 4;
+    l.texels.resize((size_t)l.tilesPerRow * ((height + 3) / 4) * 16 + 1, border);
+    return l;
+}
+
+template <class Format>
+void Texture<Format>::build(const TGAImage &img) {
+    levels.clear();
+    if (!img.data) return;
+
+    Level base = makeLevel(img.width, img.height);
+    for (int y = 0; y < img.height; y++) {
+        for (int x = 0; x < img.width; x++) {
+            base.texels[base.index(x, y)] = Format::convert(img.data + (x + y*img.width)*img.bytespp, img.bytespp);
+        }
+    }
+    levels.push_back(base);
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level &src = levels.back();
+        Level dst = makeLevel(std::max(1, src.width / 2), std::max(1, src.height / 2));
+        for (int y = 0; y < dst.height; y++) {
+            for (int x = 0; x < dst.width; x++) {
+                //the 2x2 texels under this one, an odd last row or column is reused
+                int x0 = std::min(2*x, src.width - 1), x1 = std::min(2*x + 1, src.width - 1);
+                int y0 = std::min(2*y, src.height - 1), y1 = std::min(2*y + 1, src.height - 1);
+                dst.texels[dst.index(x, y)] = Format::average(src.at(x0, y0), src.at(x1, y0), src.at(x0, y1), src.at(x1, y1));
+            }
+        }
+        levels.push_back(dst);
+    }
+}
+
+template <class Format>
+typename Texture<Format>::Texel Texture<Format>::sample(float u, float v) const {
+    if (levels.empty()) return border;
+    const Level &l = levels[0];
+    int x = (int)(u * l.width);
+    int y = (int)(v * l.height);
+    bool inside = (unsigned)x < (unsigned)l.width && (unsigned)y < (unsigned)l.height;
+    return l.texels[inside ? l.index(x, y) : l.texels.size() - 1];
+}
+
+template <class Format>
+float Texture<Format>::lod(const vector2 &dx, const vector2 &dy) const {
+    float w = (float)levels[0].width;
+    float h = (float)levels[0].height;
+    float lx = dx.x*w*dx.x*w + dx.y*h*dx.y*h;
+    float ly = dy.x*w*dy.x*w + dy.y*h*dy.y*h;
+    float rho2 = std::max(lx, ly);
+    if (!(rho2 > 1.0f)) return 0.0f;
+    return std::min(0.5f * log2f(rho2), (float)(levels.size() - 1));
+}
+
+template <class Format>
+typename Texture<Format>::Texel Texture<Format>::bilinear(int level, float u, float v) const {
+    const Level &l = levels[level];
+
+    //texel centers are at half-integer coordinates, and everything past the
+    //edges clamps to them anyway
+    float x = std::min(std::max(u * l.width - 0.5f, -1.0f), (float)l.width);
+    float y = std::min(std::max(v * l.height - 0.5f, -1.0f), (float)l.height);
+    float fx = floorf(x);
+    float fy = floorf(y);
+    int x0 = std::min(std::max((int)fx, 0), l.width - 1);
+    int x1 = std::min(std::max((int)fx + 1, 0), l.width - 1);
+    int y0 = std::min(std::max((int)fy, 0), l.height - 1);
+    int y1 = std::min(std::max((int)fy + 1, 0), l.height - 1);
+
+    Texel top = Format::lerp(l.at(x0, y0), l.at(x1, y0), x - fx);
+    Texel bottom = Format::lerp(l.at(x0, y1), l.at(x1, y1), x - fx);
+    return Format::lerp(top, bottom, y - fy);
+}
+
+template <class Format>
+typename Texture<Format>::Texel Texture<Format>::sample(float u, float v, const vector2 &dx, const vector2 &dy, TextureFilter filter) const {
+    if (filter == FILTER_NEAREST || levels.empty()) return sample(u, v);
+    if (!std::isfinite(u) || !std::isfinite(v)) return border;
+
+    float level = lod(dx, dy);
+    if (filter == FILTER_BILINEAR) return bilinear((int)(level + 0.5f), u, v);
+
+    int l0 = (int)level;
+    float t = level - l0;
+    Texel c = bilinear(l0, u, v);
+    if (t > 0.0f && l0 + 1 < (int)levels.size()) c = Format::lerp(c, bilinear(l0 + 1, u, v), t);
+    return c;
+}
+
+#endif /* texture_h */
@@ -0,0 +1,83 @@
+//
+//  texturecache.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef texturecache_h
+#define texturecache_h
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "TGAImage.h"
+#include "texture.h"
+
+//Textures by file, so every material and every model that names the same
+//file, by whatever path, samples one copy of it. The cache only holds weak
+//references: a texture lives as long as some model uses it. A file that
+//cannot be read is cached as an empty texture, which samples as the border.
+class TextureCache {
+public:
+    TextureCache() {}
+
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    //the cache models load their textures through
+    static TextureCache &shared();
+
+    template <class Format>
+    std::shared_ptr<const Texture<Format> > load(const std::string &filename);
+
+private:
+    template <class Format>
+    using TextureMap = std::map<std::string, std::weak_ptr<const Texture<Format> > >;
+
+    std::mutex mutex;
+    TextureMap<ColorTexel> colorTextures;
+    TextureMap<NormalTexel> normalTextures;
+    TextureMap<ScalarTexel> scalarTextures;
+
+    //the same file can be loaded as different formats
+    TextureMap<ColorTexel> &textures(ColorTexel) {return colorTextures;}
+    TextureMap<NormalTexel> &textures(NormalTexel) {return normalTextures;}
+    TextureMap<ScalarTexel> &textures(ScalarTexel) {return scalarTextures;}
+};
+
+TextureCache &TextureCache::shared() {
+    static TextureCache cache;
+    return cache;
+}
+
+template <class Format>
+std::shared_ptr<const Texture<Format> > TextureCache::load(const std::string &filename) {
+    char resolved[PATH_MAX];
+    std::string path = realpath(filename.c_str(), resolved) ? std::string(resolved) : filename;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::weak_ptr<const Texture<Format> > &entry = textures(Format())[path];
+    std::shared_ptr<const Texture<Format> > texture = entry.lock();
+    if (texture) return texture;
+
+    TGAImage img;
+    bool ret = img.read_tga_file(filename.c_str());
+    std::cout << "load texture file " << filename << " " << ret << std::endl;
+    img.flip_vertically();
+    std::shared_ptr<Texture<Format> > built = std::make_shared<Texture<Format> >();
+    built->build(img);
+    delete [] img.data;
+
+    entry = built;
+    return built;
+}
+
+#endif /* texturecache_h */
@@ -0,0 +1,112 @@
+//
+//  threadpool.h
+//  Eleanor
+//
+//  Created by cliff on 18/10/2026.
+//  Copyright © 2026 cliff. All rights reserved.
+//
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed set of workers that run the indices of a parallelFor.
+// The calling thread takes part as worker 0, the pool threads are 1..size()-1.
+class ThreadPool {
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+
+    const std::function<void(int, int)> *job = NULL;
+    int jobCount = 0;
+    std::atomic<int> next;
+    int generation = 0;
+    int active = 0;
+    bool quit = false;
+
+    void workerLoop(int id);
+    void runJob(int id);
+
+public:
+    ThreadPool(int n = 0) : next(0) {
+        if (n <= 0) n = std::thread::hardware_concurrency();
+        if (n <= 0) n = 1;
+        for (int i = 1; i < n; i++) {
+            threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            quit = true;
+        }
+        startCv.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    }
+
+    int size() {return (int)threads.size() + 1;}
+
+    // func(index, worker) is called once for every index in [0, count)
+    void parallelFor(int count, const std::function<void(int, int)> &func);
+};
+
+void ThreadPool::runJob(int id) {
+    int i;
+    while ((i = next++) < jobCount) {
+        (*job)(i, id);
+    }
+}
+
+void ThreadPool::workerLoop(int id) {
+    int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCv.wait(lock, [&] {return quit || generation != seen;});
+            if (quit) return;
+            seen = generation;
+        }
+
+        runJob(id);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--active == 0) doneCv.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)> &func) {
+    if (count <= 0) return;
+    if (threads.empty() || count == 1) {
+        for (int i = 0; i < count; i++) func(i, 0);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = &func;
+        jobCount = count;
+        next = 0;
+        active = (int)threads.size();
+        generation++;
+    }
+    startCv.notify_all();
+
+    runJob(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [&] {return active == 0;});
+    job = NULL;
+}
+
+#endif /* threadpool_h */
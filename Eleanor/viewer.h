@@ -33,9 +33,15 @@ private:
     int width, height;
     bool shouldQuit = false;
     bool enableZ = true;
+    bool enableTiling = true;
+    bool enableVisibility = false;
+    bool debugPresent = false;
+    bool reversedZ = false;
+    int depthFormat = DEPTH_FLOAT32;
     
     SDL_Window *sdlWindow = NULL;
     SDL_Renderer *sdlRenderer = NULL;
+    SDL_Texture *texture = NULL;
     FPSDisplay fpsDisplay;
     SoftRenderer *renderer;
     Scene *scene;
@@ -53,6 +59,12 @@ private:
     
     void update();
     
+    //copy the renderer's frame to the window
+    void present();
+    //debug fallback: one draw call per pixel, very slow
+    void presentPoints();
+    void releaseTexture();
+    
     void handleEvent();
 
 };
@@ -78,6 +90,7 @@ void Viewer::start() {
     while (!shouldQuit)
         update();
     
+    releaseTexture();
     fpsDisplay.release();
     closeSDL();
 }
@@ -87,6 +100,13 @@ void Viewer::update() {
     handleEvent();
     
     renderer->enableZTest(enableZ);
+    renderer->enableTiling(enableTiling);
+    renderer->enableVisibilityBuffer(enableVisibility);
+    renderer->setDepthFormat((DepthFormat)depthFormat);
+    
+    //reversed-Z goes with an infinite far plane
+    float far = reversedZ ? INFINITY : 100.f;
+    renderer->setReversedZ(reversedZ, 0.1f, far);
     
     SDL_SetRenderDrawColor(sdlRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(sdlRenderer);
@@ -100,7 +120,7 @@ void Viewer::update() {
     transforms.model = translate * rotate;
     
     transforms.view = scene->camera->GetViewMatrix();
-    transforms.projection = projectionFOV(scene->camera->Zoom, (float)width/(float)height, 0.1f, 100.f);
+    transforms.projection = projectionFOV(scene->camera->Zoom, (float)width/(float)height, 0.1f, far);
     
     transforms.update();
     
@@ -122,13 +142,52 @@ void Viewer::update() {
     
     renderer->model(*scene->modelNode->model, *shader[shaderId]);
     
-    renderer->draw(sdlRenderer);
+    if (debugPresent) presentPoints();
+    else present();
     
     fpsDisplay.update(sdlRenderer);
     
     SDL_RenderPresent(sdlRenderer);
 }
 
+void Viewer::present() {
+    PROFILE_TRACE(renderer->getTrace(), "present");
+    if (texture == NULL) {
+        texture = SDL_CreateTexture(sdlRenderer, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (texture == NULL) {
+            std::cout << "SDL create texture failed: " << SDL_GetError() << std::endl;
+            return;
+        }
+    }
+    
+    //the frame is already in the texture's format, upload it as is
+    //and let SDL flip the y axis when it draws
+    FrameBuffer &frame = renderer->getFrameBuffer();
+    if (SDL_UpdateTexture(texture, NULL, frame.getColor(), frame.getPitch()*sizeof(uint32_t)) < 0) return;
+    
+    SDL_RenderCopyEx(sdlRenderer, texture, NULL, NULL, 0.0, NULL, SDL_FLIP_VERTICAL);
+}
+
+void Viewer::presentPoints() {
+    PROFILE_TRACE(renderer->getTrace(), "present");
+    FrameBuffer &frame = renderer->getFrameBuffer();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            TGAColor color((unsigned char *)(frame.getColor() + x + y*frame.getPitch()), 4);
+            SDL_SetRenderDrawColor(sdlRenderer, color.bgra[2], color.bgra[1], color.bgra[0], color.bgra[3]);
+            //flip y axis
+            SDL_RenderDrawPoint(sdlRenderer, x, height - y);
+        }
+    }
+}
+
+void Viewer::releaseTexture() {
+    if (texture != NULL) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+}
+
 void Viewer::handleEvent() {
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
@@ -152,6 +211,19 @@ void Viewer::handleEvent() {
             else if (k == SDL_SCANCODE_E) rotateAngle -= 0.1;
             
             else if (k == SDL_SCANCODE_Z) enableZ = !enableZ;
+            else if (k == SDL_SCANCODE_T) enableTiling = !enableTiling;
+            else if (k == SDL_SCANCODE_V) enableVisibility = !enableVisibility;
+            else if (k == SDL_SCANCODE_R) reversedZ = !reversedZ;
+            else if (k == SDL_SCANCODE_X) depthFormat = (depthFormat + 1) % 3;
+            else if (k == SDL_SCANCODE_F) {
+                Model *model = scene->modelNode->model;
+                model->setTextureFilter((TextureFilter)((model->getTextureFilter() + 1) % 3));
+            }
+            else if (k == SDL_SCANCODE_C) renderer->setCullMode((CullMode)((renderer->getCullMode() + 1) % 3));
+            else if (k == SDL_SCANCODE_I) renderer->getStats().dump();
+#ifdef DEBUG
+            else if (k == SDL_SCANCODE_P) debugPresent = !debugPresent;
+#endif
             
             else if (k == SDL_SCANCODE_1) shaderId = 0;
             else if (k == SDL_SCANCODE_2) shaderId = 1;